@@ -0,0 +1,553 @@
+/****************************************************************/
+/* Bitsliced, constant time AES encryption                      */
+/* The state of several blocks is transposed so that bit b of   */
+/* every byte lives in word b. SubBytes then becomes a fixed    */
+/* Boolean circuit (Boyar-Peralta, 113 gates) instead of a      */
+/* secret indexed table lookup, and all blocks of a batch are   */
+/* encrypted by the same instructions.                          */
+/*                                                              */
+/* Every word holds one 64 bit slice per 4 blocks. With SSE2    */
+/* a word carries two slices, so one pass encrypts 8 blocks.    */
+/****************************************************************/
+#include "stdafx.h"
+#include "aes_encrypt.h"
+#include "aes_bitslice.h"
+#include "crypto_helper.h"
+
+#if AES_BITSLICE_SSE2
+#include <emmintrin.h>
+
+typedef __m128i BS_WORD;
+#define BS_LANES			2
+#define BS_XOR(a, b)		_mm_xor_si128(a, b)
+#define BS_AND(a, b)		_mm_and_si128(a, b)
+#define BS_OR(a, b)			_mm_or_si128(a, b)
+#define BS_NOT(a)			_mm_xor_si128(a, _mm_set1_epi32(-1))
+#define BS_SHL(a, n)		_mm_slli_epi64(a, n)
+#define BS_SHR(a, n)		_mm_srli_epi64(a, n)
+#define BS_ROTR32(a)		_mm_shuffle_epi32(a, 0xB1)
+#define BS_CONST(hi, lo)	_mm_set_epi32((int)(hi), (int)(lo), (int)(hi), (int)(lo))
+#define BS_LOAD(p)			_mm_loadu_si128((const __m128i *)(p))
+#define BS_STORE(p, x)		_mm_storeu_si128((__m128i *)(p), x)
+#define BS_FROM32(x)		_mm_cvtsi32_si128((int)(x))
+#define BS_TO32(x)			((unsigned int)_mm_cvtsi128_si32(x))
+
+#else
+
+typedef unsigned long long BS_WORD;
+#define BS_LANES			1
+#define BS_XOR(a, b)		((a) ^ (b))
+#define BS_AND(a, b)		((a) & (b))
+#define BS_OR(a, b)			((a) | (b))
+#define BS_NOT(a)			(~(a))
+#define BS_SHL(a, n)		((a) << (n))
+#define BS_SHR(a, n)		((a) >> (n))
+#define BS_ROTR32(a)		(((a) << 32) | ((a) >> 32))
+#define BS_CONST(hi, lo)	(((unsigned long long)(hi) << 32) | (unsigned long long)(lo))
+#define BS_LOAD(p)			(*(const unsigned long long *)(p))
+#define BS_STORE(p, x)		(*(unsigned long long *)(p) = (x))
+#define BS_FROM32(x)		((unsigned long long)(x))
+#define BS_TO32(x)			((unsigned int)(x))
+
+#endif
+
+#if AES_BITSLICE_BLOCKS != 4 * BS_LANES
+#error AES_BITSLICE_BLOCKS does not match the word width
+#endif
+
+/* Little endian 32 bit load/store, the bit order the slicing expects */
+static unsigned int dec32le(const unsigned char *p)
+{
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+		((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void enc32le(unsigned char *p, unsigned int x)
+{
+	p[0] = (unsigned char)x;
+	p[1] = (unsigned char)(x >> 8);
+	p[2] = (unsigned char)(x >> 16);
+	p[3] = (unsigned char)(x >> 24);
+}
+
+/*
+* Spread the four words of one block over two 64 bit slices, so that
+* after the transposition below every byte of the block lands in its
+* own bit position across the 8 words.
+*/
+static void interleave_in(unsigned long long *q0, unsigned long long *q1, const unsigned int *w)
+{
+	unsigned long long x0, x1, x2, x3;
+
+	x0 = w[0]; x1 = w[1]; x2 = w[2]; x3 = w[3];
+	x0 |= (x0 << 16); x1 |= (x1 << 16); x2 |= (x2 << 16); x3 |= (x3 << 16);
+	x0 &= 0x0000FFFF0000FFFFULL; x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL; x3 &= 0x0000FFFF0000FFFFULL;
+	x0 |= (x0 << 8); x1 |= (x1 << 8); x2 |= (x2 << 8); x3 |= (x3 << 8);
+	x0 &= 0x00FF00FF00FF00FFULL; x1 &= 0x00FF00FF00FF00FFULL;
+	x2 &= 0x00FF00FF00FF00FFULL; x3 &= 0x00FF00FF00FF00FFULL;
+	*q0 = x0 | (x2 << 8);
+	*q1 = x1 | (x3 << 8);
+}
+
+static void interleave_out(unsigned int *w, unsigned long long q0, unsigned long long q1)
+{
+	unsigned long long x0, x1, x2, x3;
+
+	x0 = q0 & 0x00FF00FF00FF00FFULL;
+	x1 = q1 & 0x00FF00FF00FF00FFULL;
+	x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+	x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+	x0 |= (x0 >> 8); x1 |= (x1 >> 8); x2 |= (x2 >> 8); x3 |= (x3 >> 8);
+	x0 &= 0x0000FFFF0000FFFFULL; x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL; x3 &= 0x0000FFFF0000FFFFULL;
+	w[0] = (unsigned int)x0 | (unsigned int)(x0 >> 16);
+	w[1] = (unsigned int)x1 | (unsigned int)(x1 >> 16);
+	w[2] = (unsigned int)x2 | (unsigned int)(x2 >> 16);
+	w[3] = (unsigned int)x3 | (unsigned int)(x3 >> 16);
+}
+
+/* 8x8 bit matrix transposition between the byte and the sliced layout */
+#define SWAPN(cl, ch, s, x, y) { \
+		BS_WORD a = (x), b = (y); \
+		(x) = BS_OR(BS_AND(a, cl), BS_SHL(BS_AND(b, cl), s)); \
+		(y) = BS_OR(BS_SHR(BS_AND(a, ch), s), BS_AND(b, ch)); \
+	}
+
+static void ortho(BS_WORD *q)
+{
+	const BS_WORD cl2 = BS_CONST(0x55555555, 0x55555555), ch2 = BS_CONST(0xAAAAAAAA, 0xAAAAAAAA);
+	const BS_WORD cl4 = BS_CONST(0x33333333, 0x33333333), ch4 = BS_CONST(0xCCCCCCCC, 0xCCCCCCCC);
+	const BS_WORD cl8 = BS_CONST(0x0F0F0F0F, 0x0F0F0F0F), ch8 = BS_CONST(0xF0F0F0F0, 0xF0F0F0F0);
+
+	SWAPN(cl2, ch2, 1, q[0], q[1]); SWAPN(cl2, ch2, 1, q[2], q[3]);
+	SWAPN(cl2, ch2, 1, q[4], q[5]); SWAPN(cl2, ch2, 1, q[6], q[7]);
+
+	SWAPN(cl4, ch4, 2, q[0], q[2]); SWAPN(cl4, ch4, 2, q[1], q[3]);
+	SWAPN(cl4, ch4, 2, q[4], q[6]); SWAPN(cl4, ch4, 2, q[5], q[7]);
+
+	SWAPN(cl8, ch8, 4, q[0], q[4]); SWAPN(cl8, ch8, 4, q[1], q[5]);
+	SWAPN(cl8, ch8, 4, q[2], q[6]); SWAPN(cl8, ch8, 4, q[3], q[7]);
+}
+
+/*
+* SubBytes on all bytes at once. The circuit is the one published by
+* Boyar and Peralta: a top linear layer, a shared GF(2^4) inversion and
+* a bottom linear layer. q[0] holds the least significant bit.
+*/
+static void bitslice_Sbox(BS_WORD *q)
+{
+	BS_WORD x0, x1, x2, x3, x4, x5, x6, x7;
+	BS_WORD y1, y2, y3, y4, y5, y6, y7, y8, y9;
+	BS_WORD y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+	BS_WORD y20, y21;
+	BS_WORD z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+	BS_WORD z10, z11, z12, z13, z14, z15, z16, z17;
+	BS_WORD t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	BS_WORD t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	BS_WORD t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	BS_WORD t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	BS_WORD t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	BS_WORD t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	BS_WORD t60, t61, t62, t63, t64, t65, t66, t67;
+	BS_WORD s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7]; x1 = q[6]; x2 = q[5]; x3 = q[4];
+	x4 = q[3]; x5 = q[2]; x6 = q[1]; x7 = q[0];
+
+	/* Top linear transformation */
+	y14 = BS_XOR(x3, x5);
+	y13 = BS_XOR(x0, x6);
+	y9 = BS_XOR(x0, x3);
+	y8 = BS_XOR(x0, x5);
+	t0 = BS_XOR(x1, x2);
+	y1 = BS_XOR(t0, x7);
+	y4 = BS_XOR(y1, x3);
+	y12 = BS_XOR(y13, y14);
+	y2 = BS_XOR(y1, x0);
+	y5 = BS_XOR(y1, x6);
+	y3 = BS_XOR(y5, y8);
+	t1 = BS_XOR(x4, y12);
+	y15 = BS_XOR(t1, x5);
+	y20 = BS_XOR(t1, x1);
+	y6 = BS_XOR(y15, x7);
+	y10 = BS_XOR(y15, t0);
+	y11 = BS_XOR(y20, y9);
+	y7 = BS_XOR(x7, y11);
+	y17 = BS_XOR(y10, y11);
+	y19 = BS_XOR(y10, y8);
+	y16 = BS_XOR(t0, y11);
+	y21 = BS_XOR(y13, y16);
+	y18 = BS_XOR(x0, y16);
+
+	/* Non-linear section */
+	t2 = BS_AND(y12, y15);
+	t3 = BS_AND(y3, y6);
+	t4 = BS_XOR(t3, t2);
+	t5 = BS_AND(y4, x7);
+	t6 = BS_XOR(t5, t2);
+	t7 = BS_AND(y13, y16);
+	t8 = BS_AND(y5, y1);
+	t9 = BS_XOR(t8, t7);
+	t10 = BS_AND(y2, y7);
+	t11 = BS_XOR(t10, t7);
+	t12 = BS_AND(y9, y11);
+	t13 = BS_AND(y14, y17);
+	t14 = BS_XOR(t13, t12);
+	t15 = BS_AND(y8, y10);
+	t16 = BS_XOR(t15, t12);
+	t17 = BS_XOR(t4, t14);
+	t18 = BS_XOR(t6, t16);
+	t19 = BS_XOR(t9, t14);
+	t20 = BS_XOR(t11, t16);
+	t21 = BS_XOR(t17, y20);
+	t22 = BS_XOR(t18, y19);
+	t23 = BS_XOR(t19, y21);
+	t24 = BS_XOR(t20, y18);
+
+	t25 = BS_XOR(t21, t22);
+	t26 = BS_AND(t21, t23);
+	t27 = BS_XOR(t24, t26);
+	t28 = BS_AND(t25, t27);
+	t29 = BS_XOR(t28, t22);
+	t30 = BS_XOR(t23, t24);
+	t31 = BS_XOR(t22, t26);
+	t32 = BS_AND(t31, t30);
+	t33 = BS_XOR(t32, t24);
+	t34 = BS_XOR(t23, t33);
+	t35 = BS_XOR(t27, t33);
+	t36 = BS_AND(t24, t35);
+	t37 = BS_XOR(t36, t34);
+	t38 = BS_XOR(t27, t36);
+	t39 = BS_AND(t29, t38);
+	t40 = BS_XOR(t25, t39);
+
+	t41 = BS_XOR(t40, t37);
+	t42 = BS_XOR(t29, t33);
+	t43 = BS_XOR(t29, t40);
+	t44 = BS_XOR(t33, t37);
+	t45 = BS_XOR(t42, t41);
+	z0 = BS_AND(t44, y15);
+	z1 = BS_AND(t37, y6);
+	z2 = BS_AND(t33, x7);
+	z3 = BS_AND(t43, y16);
+	z4 = BS_AND(t40, y1);
+	z5 = BS_AND(t29, y7);
+	z6 = BS_AND(t42, y11);
+	z7 = BS_AND(t45, y17);
+	z8 = BS_AND(t41, y10);
+	z9 = BS_AND(t44, y12);
+	z10 = BS_AND(t37, y3);
+	z11 = BS_AND(t33, y4);
+	z12 = BS_AND(t43, y13);
+	z13 = BS_AND(t40, y5);
+	z14 = BS_AND(t29, y2);
+	z15 = BS_AND(t42, y9);
+	z16 = BS_AND(t45, y14);
+	z17 = BS_AND(t41, y8);
+
+	/* Bottom linear transformation */
+	t46 = BS_XOR(z15, z16);
+	t47 = BS_XOR(z10, z11);
+	t48 = BS_XOR(z5, z13);
+	t49 = BS_XOR(z9, z10);
+	t50 = BS_XOR(z2, z12);
+	t51 = BS_XOR(z2, z5);
+	t52 = BS_XOR(z7, z8);
+	t53 = BS_XOR(z0, z3);
+	t54 = BS_XOR(z6, z7);
+	t55 = BS_XOR(z16, z17);
+	t56 = BS_XOR(z12, t48);
+	t57 = BS_XOR(t50, t53);
+	t58 = BS_XOR(z4, t46);
+	t59 = BS_XOR(z3, t54);
+	t60 = BS_XOR(t46, t57);
+	t61 = BS_XOR(z14, t57);
+	t62 = BS_XOR(t52, t58);
+	t63 = BS_XOR(t49, t58);
+	t64 = BS_XOR(z4, t59);
+	t65 = BS_XOR(t61, t62);
+	t66 = BS_XOR(z1, t63);
+	s0 = BS_XOR(t59, t63);
+	s6 = BS_XOR(t56, BS_NOT(t62));
+	s7 = BS_XOR(t48, BS_NOT(t60));
+	t67 = BS_XOR(t64, t65);
+	s3 = BS_XOR(t53, t66);
+	s4 = BS_XOR(t51, t66);
+	s5 = BS_XOR(t47, t65);
+	s1 = BS_XOR(t64, BS_NOT(s3));
+	s2 = BS_XOR(t55, BS_NOT(t67));
+
+	q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+	q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+}
+
+static void shift_rows(BS_WORD *q)
+{
+	const BS_WORD m0 = BS_CONST(0x00000000, 0x0000FFFF);
+	const BS_WORD m1 = BS_CONST(0x00000000, 0xFFF00000);
+	const BS_WORD m2 = BS_CONST(0x00000000, 0x000F0000);
+	const BS_WORD m3 = BS_CONST(0x0000FF00, 0x00000000);
+	const BS_WORD m4 = BS_CONST(0x000000FF, 0x00000000);
+	const BS_WORD m5 = BS_CONST(0xF0000000, 0x00000000);
+	const BS_WORD m6 = BS_CONST(0x0FFF0000, 0x00000000);
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		BS_WORD x = q[i];
+		q[i] = BS_OR(BS_OR(BS_OR(BS_AND(x, m0),
+			BS_SHR(BS_AND(x, m1), 4)),
+			BS_OR(BS_SHL(BS_AND(x, m2), 12),
+			BS_SHR(BS_AND(x, m3), 8))),
+			BS_OR(BS_OR(BS_SHL(BS_AND(x, m4), 8),
+			BS_SHR(BS_AND(x, m5), 12)),
+			BS_SHL(BS_AND(x, m6), 4)));
+	}
+}
+
+#define BS_ROTR16(x) BS_OR(BS_SHR(x, 16), BS_SHL(x, 48))
+
+static void mix_columns(BS_WORD *q)
+{
+	BS_WORD q0, q1, q2, q3, q4, q5, q6, q7;
+	BS_WORD r0, r1, r2, r3, r4, r5, r6, r7;
+
+	q0 = q[0]; q1 = q[1]; q2 = q[2]; q3 = q[3];
+	q4 = q[4]; q5 = q[5]; q6 = q[6]; q7 = q[7];
+	r0 = BS_ROTR16(q0); r1 = BS_ROTR16(q1); r2 = BS_ROTR16(q2); r3 = BS_ROTR16(q3);
+	r4 = BS_ROTR16(q4); r5 = BS_ROTR16(q5); r6 = BS_ROTR16(q6); r7 = BS_ROTR16(q7);
+
+	q[0] = BS_XOR(BS_XOR(q7, r7), BS_XOR(r0, BS_ROTR32(BS_XOR(q0, r0))));
+	q[1] = BS_XOR(BS_XOR(BS_XOR(q0, r0), BS_XOR(q7, r7)), BS_XOR(r1, BS_ROTR32(BS_XOR(q1, r1))));
+	q[2] = BS_XOR(BS_XOR(q1, r1), BS_XOR(r2, BS_ROTR32(BS_XOR(q2, r2))));
+	q[3] = BS_XOR(BS_XOR(BS_XOR(q2, r2), BS_XOR(q7, r7)), BS_XOR(r3, BS_ROTR32(BS_XOR(q3, r3))));
+	q[4] = BS_XOR(BS_XOR(BS_XOR(q3, r3), BS_XOR(q7, r7)), BS_XOR(r4, BS_ROTR32(BS_XOR(q4, r4))));
+	q[5] = BS_XOR(BS_XOR(q4, r4), BS_XOR(r5, BS_ROTR32(BS_XOR(q5, r5))));
+	q[6] = BS_XOR(BS_XOR(q5, r5), BS_XOR(r6, BS_ROTR32(BS_XOR(q6, r6))));
+	q[7] = BS_XOR(BS_XOR(q6, r6), BS_XOR(r7, BS_ROTR32(BS_XOR(q7, r7))));
+}
+
+static void add_round_key(BS_WORD *q, const unsigned long long *sk)
+{
+	int i;
+	for (i = 0; i < 8; i++)
+	{
+		q[i] = BS_XOR(q[i], BS_LOAD(sk + 2 * i));
+	}
+}
+
+/* Apply the S-box to the four bytes of a word without any table lookup */
+static unsigned int sub_word(unsigned int x)
+{
+	BS_WORD q[8];
+	int i;
+
+	q[0] = BS_FROM32(x);
+	for (i = 1; i < 8; i++) q[i] = BS_FROM32(0);
+	ortho(q);
+	bitslice_Sbox(q);
+	ortho(q);
+	return BS_TO32(q[0]);
+}
+
+/*
+* Constant time key expansion. Produces the same schedule as
+* KeyExpansion(), but SubWord() goes through the bitsliced S-box.
+* Any other KeyLen than 128, 192 or 256 leaves an empty schedule (Nr 0).
+*/
+void AesBitsliceExpandKey(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	)
+{
+	unsigned int w[60], tmp, rcon;
+	int Nk, Nr, i, j;
+
+	if (KeyLen != 128 && KeyLen != 192 && KeyLen != 256)
+	{
+		memset(pExpandedKey, 0, sizeof(AES_EXPANDED_KEY));
+		return;
+	}
+	Nk = KeyLen / 32;
+	Nr = Nk + 6;
+
+	for (i = 0; i < Nk; i++)
+	{
+		w[i] = dec32le(pKey + 4 * i);
+	}
+
+	tmp = w[Nk - 1];
+	rcon = 0x01;
+	for (i = Nk, j = 0; i < 4 * (Nr + 1); i++)
+	{
+		if (j == 0)
+		{
+			// RotWord() then SubWord(), the words are little endian
+			tmp = (tmp >> 8) | (tmp << 24);
+			tmp = sub_word(tmp) ^ rcon;
+			rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+		}
+		else if (Nk > 6 && j == 4)
+		{
+			tmp = sub_word(tmp);
+		}
+		tmp ^= w[i - Nk];
+		w[i] = tmp;
+		if (++j == Nk) j = 0;
+	}
+
+	for (i = 0; i < 4 * (Nr + 1); i++)
+	{
+		enc32le(pExpandedKey->RoundKey + 4 * i, w[i]);
+	}
+	pExpandedKey->Nr = Nr;
+}
+
+/*
+* Convert an expanded key into sliced round keys: every round key is
+* replicated into all block positions and transposed like the state.
+*/
+void AesBitsliceKeyFromExpanded(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	AES_BITSLICE_KEY *pBitsliceKey
+	)
+{
+	unsigned int w[4];
+	unsigned long long q0, q1;
+	unsigned long long lanes[8][2];
+	BS_WORD q[8];
+	int round, i;
+
+	pBitsliceKey->Nr = pExpandedKey->Nr;
+	for (round = 0; round <= pExpandedKey->Nr; round++)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			w[i] = dec32le(pExpandedKey->RoundKey + 16 * round + 4 * i);
+		}
+		interleave_in(&q0, &q1, w);
+		for (i = 0; i < 4; i++)
+		{
+			lanes[i][0] = lanes[i][1] = q0;
+			lanes[i + 4][0] = lanes[i + 4][1] = q1;
+		}
+		for (i = 0; i < 8; i++) q[i] = BS_LOAD(lanes[i]);
+		ortho(q);
+		for (i = 0; i < 8; i++) BS_STORE(lanes[i], q[i]);
+		for (i = 0; i < 8; i++)
+		{
+			pBitsliceKey->SubKeys[(round * 8 + i) * 2] = lanes[i][0];
+			pBitsliceKey->SubKeys[(round * 8 + i) * 2 + 1] = lanes[i][1];
+		}
+	}
+}
+
+void AesBitsliceSetKey(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	unsigned char *pKey,
+	AES_BITSLICE_KEY *pBitsliceKey
+	)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+
+	AesBitsliceExpandKey(KeyLen, pKey, &ExpandedKey);
+	AesBitsliceKeyFromExpanded(&ExpandedKey, pBitsliceKey);
+	SecureWipe(&ExpandedKey, sizeof(ExpandedKey));
+}
+
+/* Encrypt exactly AES_BITSLICE_BLOCKS blocks */
+static void AesBitsliceEncryptBatch(
+	const AES_BITSLICE_KEY *pBitsliceKey,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	unsigned int w[4];
+	unsigned long long lanes[8][2];
+	BS_WORD q[8];
+	int lane, blk, i, round;
+
+	// Block (4 * lane + blk) goes to slice 'lane' of words blk and blk + 4
+	for (lane = 0; lane < BS_LANES; lane++)
+	{
+		for (blk = 0; blk < 4; blk++)
+		{
+			const unsigned char *p = pPlainTextData + 16 * (4 * lane + blk);
+			for (i = 0; i < 4; i++) w[i] = dec32le(p + 4 * i);
+			interleave_in(&lanes[blk][lane], &lanes[blk + 4][lane], w);
+		}
+	}
+	for (i = 0; i < 8; i++) q[i] = BS_LOAD(lanes[i]);
+	ortho(q);
+
+	add_round_key(q, pBitsliceKey->SubKeys);
+	for (round = 1; round < pBitsliceKey->Nr; round++)
+	{
+		bitslice_Sbox(q);
+		shift_rows(q);
+		mix_columns(q);
+		add_round_key(q, pBitsliceKey->SubKeys + round * 16);
+	}
+	bitslice_Sbox(q);
+	shift_rows(q);
+	add_round_key(q, pBitsliceKey->SubKeys + pBitsliceKey->Nr * 16);
+
+	ortho(q);
+	for (i = 0; i < 8; i++) BS_STORE(lanes[i], q[i]);
+	for (lane = 0; lane < BS_LANES; lane++)
+	{
+		for (blk = 0; blk < 4; blk++)
+		{
+			unsigned char *p = pEncryptedData + 16 * (4 * lane + blk);
+			interleave_out(w, lanes[blk][lane], lanes[blk + 4][lane]);
+			for (i = 0; i < 4; i++) enc32le(p + 4 * i, w[i]);
+		}
+	}
+}
+
+// Encrypt 'Blocks' independent 16 byte blocks (ECB) under one key.
+// Full batches of AES_BITSLICE_BLOCKS go straight through the sliced
+// cipher; a shorter tail is padded in a local buffer.
+void AesBitsliceEncrypt(
+	const AES_BITSLICE_KEY *pBitsliceKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Blocks
+	)
+{
+	unsigned char tail[16 * AES_BITSLICE_BLOCKS];
+
+	while (Blocks >= AES_BITSLICE_BLOCKS)
+	{
+		AesBitsliceEncryptBatch(pBitsliceKey, pPlainTextData, pEncryptedData);
+		pPlainTextData += 16 * AES_BITSLICE_BLOCKS;
+		pEncryptedData += 16 * AES_BITSLICE_BLOCKS;
+		Blocks -= AES_BITSLICE_BLOCKS;
+	}
+	if (Blocks > 0)
+	{
+		memset(tail, 0, sizeof(tail));
+		memcpy(tail, pPlainTextData, 16 * Blocks);
+		AesBitsliceEncryptBatch(pBitsliceKey, tail, tail);
+		memcpy(pEncryptedData, tail, 16 * Blocks);
+		SecureWipe(tail, sizeof(tail));
+	}
+}
+
+// Single block entry point for AES_ENGINE_BITSLICE. Slicing the key costs
+// more than the block itself, so prefer AesBitsliceEncrypt for bulk work;
+// this exists to keep every AES call free of secret indexed lookups.
+void AesBitsliceEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	AES_BITSLICE_KEY BitsliceKey;
+
+	AesBitsliceKeyFromExpanded(pExpandedKey, &BitsliceKey);
+	AesBitsliceEncrypt(&BitsliceKey, pPlainTextData, pEncryptedData, 1);
+	SecureWipe(&BitsliceKey, sizeof(BitsliceKey));
+}
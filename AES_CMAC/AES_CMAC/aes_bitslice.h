@@ -0,0 +1,54 @@
+#ifndef __AES_BITSLICE_H
+#define __AES_BITSLICE_H
+
+#include "aes_encrypt.h"
+
+// SSE2 doubles the word width of the sliced cipher
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AES_BITSLICE_SSE2 1
+#define AES_BITSLICE_BLOCKS 8
+#else
+#define AES_BITSLICE_SSE2 0
+#define AES_BITSLICE_BLOCKS 4
+#endif
+
+// Sliced round keys: 8 words of 128 bits per round, up to 14 rounds
+typedef struct AES_ALIGN(16) _AES_BITSLICE_KEY
+{
+	unsigned long long SubKeys[15 * 8 * 2];
+	int Nr;
+} AES_BITSLICE_KEY;
+
+// Constant time key expansion into the common expanded key layout
+void AesBitsliceExpandKey(
+	unsigned long KeyLen,
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	);
+
+void AesBitsliceKeyFromExpanded(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	AES_BITSLICE_KEY *pBitsliceKey
+	);
+
+void AesBitsliceSetKey(
+	unsigned long KeyLen,
+	unsigned char *pKey,
+	AES_BITSLICE_KEY *pBitsliceKey
+	);
+
+// Bitsliced AES Encrypt, AES_BITSLICE_BLOCKS blocks per pass
+void AesBitsliceEncrypt(
+	const AES_BITSLICE_KEY *pBitsliceKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Blocks
+	);
+
+void AesBitsliceEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+#endif
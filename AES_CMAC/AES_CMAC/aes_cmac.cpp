@@ -6,6 +6,7 @@
 /****************************************************************/
 #include "stdafx.h"
 #include "aes_encrypt.h"
+#include "aes_cmac.h"
 #include "crypto_helper.h"
 
 /* For CMAC Calculation */
@@ -33,14 +34,14 @@ void leftshift_onebit(unsigned char *input, unsigned char *output)
 	return;
 }
 
-void generate_subkey(unsigned char *key, unsigned char *K1, unsigned char *K2)
+void generate_subkey_expanded(const AES_EXPANDED_KEY *key, unsigned char *K1, unsigned char *K2)
 {
 	unsigned char L[16];
 	unsigned char Z[16];
 	unsigned char tmp[16];
 	int i;
 	for (i = 0; i < 16; i++) Z[i] = 0;
-	AES_128(key, Z, L);
+	AesEncryptBlock(key, Z, L);
 	if ((L[0] & 0x80) == 0) { /* If MSB(L) = 0, then K1 = L << 1 */
 		leftshift_onebit(L, K1);
 	}
@@ -58,6 +59,13 @@ void generate_subkey(unsigned char *key, unsigned char *K1, unsigned char *K2)
 	return;
 }
 
+void generate_subkey(unsigned char *key, unsigned char *K1, unsigned char *K2)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+	AES_128_ExpandKey(key, &ExpandedKey);
+	generate_subkey_expanded(&ExpandedKey, K1, K2);
+}
+
 void padding(unsigned char *lastb, unsigned char *pad, int length)
 {
 	int         j;
@@ -74,12 +82,18 @@ void padding(unsigned char *lastb, unsigned char *pad, int length)
 		}
 	}
 }
-void AES_CMAC(unsigned char *key, unsigned char *input, int length, unsigned char *mac)
+
+/* Expand the key and derive K1, K2 once for any number of messages */
+void AES_CMAC_Init(AES_CMAC_KEY *ctx, unsigned char *key)
+{
+	AES_128_ExpandKey(key, &ctx->Key);
+	generate_subkey_expanded(&ctx->Key, ctx->K1, ctx->K2);
+}
+
+void AES_CMAC_Sign(const AES_CMAC_KEY *ctx, unsigned char *input, int length, unsigned char *mac)
 {
 	unsigned char       X[16], Y[16], M_last[16], padded[16];
-	unsigned char       K1[16], K2[16];
 	int         n, i, flag;
-	generate_subkey(key, K1, K2);
 	n = (length + 15) / 16;       /* n is number of rounds */
 	if (n == 0) {
 		n = 1;
@@ -95,27 +109,275 @@ void AES_CMAC(unsigned char *key, unsigned char *input, int length, unsigned cha
 	}
 
 	if (flag) { /* last block is complete block */
-		xor_128(&input[16 * (n - 1)], K1, M_last);
+		xor_128(&input[16 * (n - 1)], (unsigned char *)ctx->K1, M_last);
 	}
 	else {
 		padding(&input[16 * (n - 1)], padded, length % 16);
-		xor_128(padded, K2, M_last);
+		xor_128(padded, (unsigned char *)ctx->K2, M_last);
 	}
 
 	for (i = 0; i < 16; i++) X[i] = 0;
 
 	for (i = 0; i < n - 1; i++) {
 		xor_128(X, &input[16 * i], Y); /* Y := Mi (+) X  */
-		AES_128(key, Y, X);      /* X := AES-128(KEY, Y); */
+		AesEncryptBlock(&ctx->Key, Y, X); /* X := AES-128(KEY, Y); */
 	}
 
 	xor_128(X, M_last, Y);
-	AES_128(key, Y, X);
+	AesEncryptBlock(&ctx->Key, Y, X);
 	for (i = 0; i < 16; i++) {
 		mac[i] = X[i];
 	}
 }
 
+/* Returns 1 when mac is the tag of input; the tags are compared in constant time */
+int AES_CMAC_Verify(const AES_CMAC_KEY *ctx, unsigned char *input, int length, const unsigned char *mac)
+{
+	unsigned char T[16], diff = 0;
+	int i;
+	AES_CMAC_Sign(ctx, input, length, T);
+	for (i = 0; i < 16; i++) {
+		diff |= T[i] ^ mac[i];
+	}
+	return diff == 0;
+}
+
+/*
+* Cursor over a segment list. Hands out the message a block at a time:
+* a pointer into the segment when the bytes lie in one, otherwise the
+* bytes are gathered into the caller's 16 byte block.
+*/
+typedef struct _CMAC_CURSOR
+{
+	const AES_CMAC_SEGMENT *seg;
+	int count;
+	int idx;
+	int off;
+} CMAC_CURSOR;
+
+static int segments_length(const AES_CMAC_SEGMENT *seg, int count)
+{
+	int i, length = 0;
+	for (i = 0; i < count; i++) length += seg[i].length;
+	return length;
+}
+
+static void cursor_init(CMAC_CURSOR *c, const AES_CMAC_SEGMENT *seg, int count)
+{
+	c->seg = seg;
+	c->count = count;
+	c->idx = 0;
+	c->off = 0;
+}
+
+static unsigned char *cursor_next(CMAC_CURSOR *c, int n, unsigned char *block)
+{
+	const unsigned char *p;
+	int got = 0, take;
+	while (c->idx < c->count && c->off == c->seg[c->idx].length) {
+		c->idx++;
+		c->off = 0;
+	}
+	if (c->idx < c->count && c->seg[c->idx].length - c->off >= n) {
+		p = c->seg[c->idx].data + c->off;   /* no copy */
+		c->off += n;
+		return (unsigned char *)p;
+	}
+	while (got < n) {   /* the block straddles segments */
+		while (c->off == c->seg[c->idx].length) {
+			c->idx++;
+			c->off = 0;
+		}
+		take = c->seg[c->idx].length - c->off;
+		if (take > n - got) take = n - got;
+		memcpy(block + got, c->seg[c->idx].data + c->off, take);
+		got += take;
+		c->off += take;
+	}
+	return block;
+}
+
+/* AES-CMAC over the concatenation of the segments, without joining them */
+void AES_CMAC_SignSegments(const AES_CMAC_KEY *ctx, const AES_CMAC_SEGMENT *seg, int count, unsigned char *mac)
+{
+	unsigned char       X[16], Y[16], block[16], padded[16];
+	unsigned char       *M;
+	CMAC_CURSOR         cur;
+	int         length, n, i, last;
+	length = segments_length(seg, count);
+	n = (length + 15) / 16;       /* n is number of rounds */
+	if (n == 0) n = 1;
+	last = length - 16 * (n - 1); /* bytes in the last block, 0 to 16 */
+	cursor_init(&cur, seg, count);
+
+	for (i = 0; i < 16; i++) X[i] = 0;
+
+	for (i = 0; i < n - 1; i++) {
+		M = cursor_next(&cur, 16, block);
+		xor_128(X, M, Y); /* Y := Mi (+) X  */
+		AesEncryptBlock(&ctx->Key, Y, X); /* X := AES-128(KEY, Y); */
+	}
+
+	M = cursor_next(&cur, last, block);
+	if (last == 16) { /* last block is complete block */
+		xor_128(X, M, Y);
+		xor_128(Y, (unsigned char *)ctx->K1, Y);
+	}
+	else {
+		padding(M, padded, last);
+		xor_128(X, padded, Y);
+		xor_128(Y, (unsigned char *)ctx->K2, Y);
+	}
+	AesEncryptBlock(&ctx->Key, Y, mac);
+}
+
+/*
+* Streaming AES-CMAC. The last block is only known once AES_CMAC_Final is
+* called, so up to 16 bytes are held back in Buf: a full buffer is only
+* chained in when more input follows it.
+*/
+void AES_CMAC_Start(AES_CMAC_CTX *ctx, const AES_CMAC_KEY *key)
+{
+	ctx->Key = key;
+	memset(ctx->X, 0, 16);
+	ctx->BufLen = 0;
+}
+
+void AES_CMAC_Update(AES_CMAC_CTX *ctx, const unsigned char *input, unsigned int length)
+{
+	unsigned char       Y[16];
+	unsigned int        take;
+	while (length > 0) {
+		if (ctx->BufLen == 16) {   /* more input follows, Buf is not the last block */
+			xor_128(ctx->X, ctx->Buf, Y);
+			AesEncryptBlock(&ctx->Key->Key, Y, ctx->X);
+			ctx->BufLen = 0;
+		}
+		if (ctx->BufLen == 0 && length > 16) {   /* whole blocks straight from input */
+			xor_128(ctx->X, (unsigned char *)input, Y);
+			AesEncryptBlock(&ctx->Key->Key, Y, ctx->X);
+			input += 16;
+			length -= 16;
+			continue;
+		}
+		take = 16 - ctx->BufLen;
+		if (take > length) take = length;
+		memcpy(ctx->Buf + ctx->BufLen, input, take);
+		ctx->BufLen += take;
+		input += take;
+		length -= take;
+	}
+}
+
+void AES_CMAC_Final(AES_CMAC_CTX *ctx, unsigned char *mac)
+{
+	unsigned char       Y[16], M_last[16], padded[16];
+	if (ctx->BufLen == 16) { /* last block is complete block */
+		xor_128(ctx->Buf, (unsigned char *)ctx->Key->K1, M_last);
+	}
+	else {
+		padding(ctx->Buf, padded, ctx->BufLen);
+		xor_128(padded, (unsigned char *)ctx->Key->K2, M_last);
+	}
+	xor_128(ctx->X, M_last, Y);
+	AesEncryptBlock(&ctx->Key->Key, Y, mac);
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+/*
+* Batch AES-CMAC over independent messages. Every lane runs one CMAC chain;
+* each step encrypts the next block of all busy lanes with one
+* AesEncryptBlocks call, so the AES-NI engine keeps up to AES_CMAC_LANES
+* blocks in flight. A lane whose message ends takes the next job at once,
+* so messages of different lengths and keys keep the lanes full.
+*/
+void AES_CMAC_Batch(AES_CMAC_JOB *jobs, int count)
+{
+	const AES_EXPANDED_KEY *keys[AES_CMAC_LANES];
+	unsigned char       Y[16 * AES_CMAC_LANES], X[16 * AES_CMAC_LANES], block[16], padded[16];
+	AES_CMAC_JOB        *lane_job[AES_CMAC_LANES];
+	AES_CMAC_SEGMENT    lane_input[AES_CMAC_LANES];
+	CMAC_CURSOR         lane_cur[AES_CMAC_LANES];
+	int                 lane_block[AES_CMAC_LANES], lane_n[AES_CMAC_LANES], lane_last[AES_CMAC_LANES];
+	int                 next = 0, busy, l, active, length;
+	int                 lanes = count < AES_CMAC_LANES ? count : AES_CMAC_LANES;   /* lanes the jobs can fill */
+	for (l = 0; l < lanes; l++) lane_job[l] = NULL;
+	for (;;) {
+		/* refill idle lanes */
+		for (l = 0; l < lanes; l++) {
+			if (lane_job[l] == NULL && next < count) {
+				AES_CMAC_JOB *job = &jobs[next++];
+				if (job->segments != NULL) {
+					cursor_init(&lane_cur[l], job->segments, job->segment_count);
+					length = segments_length(job->segments, job->segment_count);
+				}
+				else {
+					lane_input[l].data = job->input;
+					lane_input[l].length = job->length;
+					cursor_init(&lane_cur[l], &lane_input[l], 1);
+					length = job->length;
+				}
+				lane_job[l] = job;
+				lane_block[l] = 0;
+				lane_n[l] = (length + 15) / 16;
+				if (lane_n[l] == 0) lane_n[l] = 1;
+				lane_last[l] = length - 16 * (lane_n[l] - 1);
+				memset(&X[16 * l], 0, 16);
+			}
+		}
+		/* Y := Mi (+) X for every busy lane, the last block with K1 or K2 */
+		active = 0;
+		for (l = 0; l < lanes; l++) {
+			AES_CMAC_JOB *job = lane_job[l];
+			unsigned char *M;
+			if (job == NULL) continue;
+			if (lane_block[l] < lane_n[l] - 1) {
+				M = cursor_next(&lane_cur[l], 16, block);
+				xor_128(&X[16 * l], M, &Y[16 * active]);
+			}
+			else if (lane_last[l] == 16) {
+				M = cursor_next(&lane_cur[l], 16, block);
+				xor_128(&X[16 * l], M, &Y[16 * active]);
+				xor_128(&Y[16 * active], (unsigned char *)job->key->K1, &Y[16 * active]);
+			}
+			else {
+				M = cursor_next(&lane_cur[l], lane_last[l], block);
+				padding(M, padded, lane_last[l]);
+				xor_128(&X[16 * l], padded, &Y[16 * active]);
+				xor_128(&Y[16 * active], (unsigned char *)job->key->K2, &Y[16 * active]);
+			}
+			keys[active++] = &job->key->Key;
+		}
+		if (active == 0) break;
+		/* X := AES-128(KEY, Y); with every lane busy Y is already in lane order */
+		if (active == lanes) {
+			AesEncryptBlocks(keys, Y, X, active);
+		}
+		else {
+			AesEncryptBlocks(keys, Y, Y, active);
+			busy = 0;
+			for (l = 0; l < lanes; l++) {
+				if (lane_job[l] != NULL) memcpy(&X[16 * l], &Y[16 * busy++], 16);
+			}
+		}
+		/* retire finished lanes */
+		for (l = 0; l < lanes; l++) {
+			if (lane_job[l] != NULL && ++lane_block[l] == lane_n[l]) {
+				memcpy(lane_job[l]->mac, &X[16 * l], 16);
+				lane_job[l] = NULL;
+			}
+		}
+	}
+}
+
+void AES_CMAC(unsigned char *key, unsigned char *input, int length, unsigned char *mac)
+{
+	AES_CMAC_KEY        ctx;
+	AES_CMAC_Init(&ctx, key);   /* expand once for all blocks */
+	AES_CMAC_Sign(&ctx, input, length, mac);
+	SecureWipe(&ctx, sizeof(ctx));
+}
+
 
 /************************************************************************************/
 //				Function Tester
@@ -152,6 +414,13 @@ void AES_CMAC(unsigned char *key, unsigned char *input, int length, unsigned cha
 int AES_CMAC_Test(void)
 {
 	unsigned char L[16], K1[16], K2[16], T[16];
+	AES_CMAC_KEY ctx;
+	AES_CMAC_CTX stream;
+	AES_CMAC_JOB jobs[4];
+	AES_CMAC_SEGMENT seg[4];
+	unsigned char macs[4][16];
+	int lens[4] = { 0, 16, 40, 64 };
+	int i;
 	unsigned char M[64] = {
 		0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
 		0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
@@ -196,6 +465,36 @@ int AES_CMAC_Test(void)
 	printf("M              "); print_hex("               ", M, 64);
 	AES_CMAC(key, M, 64, T);
 	printf("AES_CMAC       "); print128(T); printf("\n");
+
+	AES_CMAC_Init(&ctx, key);
+	AES_CMAC_Start(&stream, &ctx);
+	AES_CMAC_Update(&stream, M, 1);
+	AES_CMAC_Update(&stream, M + 1, 20);
+	AES_CMAC_Update(&stream, M + 21, 0);
+	AES_CMAC_Update(&stream, M + 21, 43);
+	AES_CMAC_Final(&stream, T);
+	printf("\nAES_CMAC_Final "); print128(T); printf("\n");
+	for (i = 0; i < 4; i++) {
+		jobs[i].key = &ctx;
+		jobs[i].input = M;
+		jobs[i].length = lens[i];
+		jobs[i].segments = NULL;
+		jobs[i].mac = macs[i];
+	}
+	AES_CMAC_Batch(jobs, 4);
+	printf("AES_CMAC_Batch "); print128(macs[0]); printf("\n");
+	printf("               "); print128(macs[1]); printf("\n");
+	printf("               "); print128(macs[2]); printf("\n");
+	printf("               "); print128(macs[3]); printf("\n");
+	printf("AES_CMAC_Verify %s\n", AES_CMAC_Verify(&ctx, M, 64, T) && !AES_CMAC_Verify(&ctx, M, 63, T) ? "pass" : "FAIL");
+
+	/* example 3 split into segments, one of them empty */
+	seg[0].data = M; seg[0].length = 7;
+	seg[1].data = M + 7; seg[1].length = 0;
+	seg[2].data = M + 7; seg[2].length = 30;
+	seg[3].data = M + 37; seg[3].length = 3;
+	AES_CMAC_SignSegments(&ctx, seg, 4, T);
+	printf("AES_CMAC(segs) "); print128(T); printf("\n");
 	printf("--------------------------------------------------\n");
 	return 0;
 }
@@ -1,6 +1,8 @@
 #ifndef __AES_CMAC_H
 #define __AES_CMAC_H
 
+#include "aes_encrypt.h"
+
 void AES_CMAC(
 	unsigned char *key, 
 	unsigned char *input, 
@@ -8,6 +10,92 @@ void AES_CMAC(
 	unsigned char *mac
 );
 
+// AES-CMAC key: the expanded key and its subkeys K1, K2, derived once and
+// reused for every message signed or verified with it
+typedef struct _AES_CMAC_KEY
+{
+	AES_EXPANDED_KEY Key;			// expanded key schedule
+	unsigned char K1[16];			// subkey for a complete last block
+	unsigned char K2[16];			// subkey for a padded last block
+} AES_CMAC_KEY;
+
+void AES_CMAC_Init(
+	AES_CMAC_KEY *ctx,
+	unsigned char *key
+);
+
+void AES_CMAC_Sign(
+	const AES_CMAC_KEY *ctx,
+	unsigned char *input,
+	int length,
+	unsigned char *mac
+);
+
+int AES_CMAC_Verify(
+	const AES_CMAC_KEY *ctx,
+	unsigned char *input,
+	int length,
+	const unsigned char *mac
+);
+
+// Scatter-gather AES-CMAC: the message is the concatenation of the segments
+typedef struct _AES_CMAC_SEGMENT
+{
+	const unsigned char *data;
+	int length;
+} AES_CMAC_SEGMENT;
+
+void AES_CMAC_SignSegments(
+	const AES_CMAC_KEY *ctx,
+	const AES_CMAC_SEGMENT *seg,
+	int count,
+	unsigned char *mac
+);
+
+// Streaming AES-CMAC: Start, Update with chunks of any length, Final.
+// The key must stay valid until AES_CMAC_Final returns.
+typedef struct _AES_CMAC_CTX
+{
+	const AES_CMAC_KEY *Key;		// key and subkeys
+	unsigned char X[16];			// chaining value
+	unsigned char Buf[16];			// pending (possibly last) block
+	unsigned int BufLen;			// bytes in Buf
+} AES_CMAC_CTX;
+
+void AES_CMAC_Start(
+	AES_CMAC_CTX *ctx,
+	const AES_CMAC_KEY *key
+);
+
+void AES_CMAC_Update(
+	AES_CMAC_CTX *ctx,
+	const unsigned char *input,
+	unsigned int length
+);
+
+void AES_CMAC_Final(
+	AES_CMAC_CTX *ctx,
+	unsigned char *mac
+);
+
+// Batch AES-CMAC: one tag per job, each job with its own key and length
+#define AES_CMAC_LANES	8
+
+typedef struct _AES_CMAC_JOB
+{
+	const AES_CMAC_KEY *key;		// key and subkeys
+	unsigned char *input;			// message
+	int length;						// message length in bytes
+	const AES_CMAC_SEGMENT *segments;	// or, when not NULL, the message in pieces
+	int segment_count;
+	unsigned char *mac;				// 16 byte tag out
+} AES_CMAC_JOB;
+
+void AES_CMAC_Batch(
+	AES_CMAC_JOB *jobs,
+	int count
+);
+
 int AES_CMAC_Test(void);
 
 #endif
\ No newline at end of file
@@ -33,31 +33,18 @@ http://en.wikipedia.org/wiki/Advanced_Encryption_Standard
 // Used for giving output to the screen.
 
 #include "stdafx.h"
+#include "aes_encrypt.h"
+#include "aes_ttable.h"
+#include "aes_ni.h"
+#include "aes_bitslice.h"
+#include "aes_template.h"
 #include "crypto_helper.h"
 
 // The number of columns comprising a state in AES. This is a constant in AES. Value=4
 #define Nb 4
 
-// The number of rounds in AES Cipher. It is simply initiated to zero. The actual value is recieved in the program.
-int Nr = 0;
-
-// The number of 32 bit words in the key. It is simply initiated to zero. The actual value is recieved in the program.
-int Nk = 0;
-
-// in - it is the array that holds the plain text to be encrypted.
-// out - it is the array that holds the key for encryption.
-// state - the array that holds the intermediate results during encryption.
-unsigned char in[16], out[16], state[4][4];
-
-// The array that stores the round keys.
-unsigned char RoundKey[240];
-
-// The Key input to the AES Program
-unsigned char Key[32];
-
-unsigned char getSBoxValue(int num)
-{
-	unsigned char sbox[256] =   {
+// The S-box. Kept at file scope so a lookup does not rebuild it on the stack.
+static const unsigned char sbox[256] =   {
 	//0     1    2      3     4    5     6     7      8    9     A      B    C     D     E     F
 	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76, //0
 	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, //1
@@ -75,13 +62,16 @@ unsigned char getSBoxValue(int num)
 	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, //D
 	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf, //E
 	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 }; //F
+
+unsigned char getSBoxValue(int num)
+{
 	return sbox[num];
 }
 
 // The round constant word array, Rcon[i], contains the values given by 
 // x to th e power (i-1) being powers of x (x is denoted as {02}) in the field GF(28)
 // Note that i starts at 1, not 0).
-unsigned char Rcon[255] = {
+static const unsigned char Rcon[255] = {
 	0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36, 0x6c, 0xd8, 0xab, 0x4d, 0x9a, 
 	0x2f, 0x5e, 0xbc, 0x63, 0xc6, 0x97, 0x35, 0x6a, 0xd4, 0xb3, 0x7d, 0xfa, 0xef, 0xc5, 0x91, 0x39, 
 	0x72, 0xe4, 0xd3, 0xbd, 0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a, 
@@ -100,7 +90,7 @@ unsigned char Rcon[255] = {
 	0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a, 0x74, 0xe8, 0xcb  };
 
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to encrypt the states. 
-void KeyExpansion()
+static void KeyExpansion(unsigned char *RoundKey, int Nk, int Nr, const unsigned char *Key)
 {
 	int i,j;
 	unsigned char temp[4],k;
@@ -169,21 +159,21 @@ void KeyExpansion()
 
 // This function adds the round key to state.
 // The round key is added to the state by an XOR function.
-void AddRoundKey(int round) 
+static void AddRoundKey(unsigned char state[4][4], const AES_EXPANDED_KEY *key, int round) 
 {
 	int i,j;
 	for(i=0;i<4;i++)
 	{
 		for(j=0;j<4;j++)
 		{
-			state[j][i] ^= RoundKey[round * Nb * 4 + i * Nb + j];
+			state[j][i] ^= key->RoundKey[round * Nb * 4 + i * Nb + j];
 		}
 	}
 }
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-void SubBytes()
+static void SubBytes(unsigned char state[4][4])
 {
 	int i,j;
 	for(i=0;i<4;i++)
@@ -199,7 +189,7 @@ void SubBytes()
 // The ShiftRows() function shifts the rows in the state to the left.
 // Each row is shifted with different offset.
 // Offset = Row number. So the first row is not shifted.
-void ShiftRows()
+static void ShiftRows(unsigned char state[4][4])
 {
 	unsigned char temp;
 
@@ -231,7 +221,7 @@ void ShiftRows()
 #define xtime(x)   ((x<<1) ^ (((x>>7) & 1) * 0x1b))
 
 // MixColumns function mixes the columns of the state matrix
-void MixColumns()
+static void MixColumns(unsigned char state[4][4])
 {
 	int i;
 	unsigned char Tmp,Tm,t;
@@ -247,7 +237,7 @@ void MixColumns()
 }
 
 // Cipher is the main function that encrypts the PlainText.
-void Cipher()
+static void Cipher(const AES_EXPANDED_KEY *key, unsigned char state[4][4], const unsigned char *in, unsigned char *out)
 {
 	int i,j,round=0;
 
@@ -261,24 +251,24 @@ void Cipher()
 	}
 
 	// Add the First round key to the state before starting the rounds.
-	AddRoundKey(0); 
+	AddRoundKey(state, key, 0); 
 	
 	// There will be Nr rounds.
 	// The first Nr-1 rounds are identical.
 	// These Nr-1 rounds are executed in the loop below.
-	for(round=1;round<Nr;round++)
+	for(round=1;round<key->Nr;round++)
 	{
-		SubBytes();
-		ShiftRows();
-		MixColumns();
-		AddRoundKey(round);
+		SubBytes(state);
+		ShiftRows(state);
+		MixColumns(state);
+		AddRoundKey(state, key, round);
 	}
 	
 	// The last round is given below.
 	// The MixColumns function is not here in the last round.
-	SubBytes();
-	ShiftRows();
-	AddRoundKey(Nr);
+	SubBytes(state);
+	ShiftRows(state);
+	AddRoundKey(state, key, key->Nr);
 
 	// The encryption process is over.
 	// Copy the state array to output array.
@@ -292,39 +282,335 @@ void Cipher()
 }
 
 
-void AesEncrypt(
+// Portable key expansion, used by the reference and T-table engines.
+static void AesSoftwareExpandKey(
 	unsigned long KeyLen,	// KeyLen = 128, 192, 256
 	unsigned char *pKey,
-	unsigned char *pPlainTextData,
-	unsigned char *pEncryptedData
+	AES_EXPANDED_KEY *pExpandedKey
 	)
 {
-	int i;
+	int Nk;
 
 	// Calculate Nk and Nr from the recieved value.
 	Nk = KeyLen / 32;
-	Nr = Nk + 6;
-	
-	// Copy the Key and PlainText
-	for(i=0;i<Nk*4;i++)
+	pExpandedKey->Nr = Nk + 6;
+
+	KeyExpansion(pExpandedKey->RoundKey, Nk, pExpandedKey->Nr, pKey);
+}
+
+// The reference cipher: byte wise SubBytes/ShiftRows/MixColumns on the state matrix.
+static void AesReferenceEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	unsigned char state[4][4];
+
+	Cipher(pExpandedKey, state, pPlainTextData, pEncryptedData);
+}
+
+// Block cipher and key expansion selected by AesSetEngine. All engines
+// share the expanded key layout, so a key may be expanded before or after
+// switching.
+typedef void (*AES_BLOCK_FUNC)(const AES_EXPANDED_KEY *, unsigned char *, unsigned char *);
+typedef void (*AES_EXPAND_FUNC)(unsigned long, unsigned char *, AES_EXPANDED_KEY *);
+
+static AES_ENGINE AesEngine = AES_ENGINE_TTABLE;
+static AES_BLOCK_FUNC AesBlockFunc = AesTTableEncryptBlock;
+static AES_EXPAND_FUNC AesExpandFunc = AesSoftwareExpandKey;
+
+// Select the engine used by every AES entry point. AES_ENGINE_AESNI falls
+// back to the T-table engine on CPUs without the AES instructions.
+// The engine and its functions are plain variables: only switch engines
+// while no other thread is using AES.
+void AesSetEngine(AES_ENGINE Engine)
+{
+	if (Engine == AES_ENGINE_AESNI && !AesNiSupported())
+	{
+		Engine = AES_ENGINE_TTABLE;
+	}
+
+	switch (Engine)
+	{
+	case AES_ENGINE_REFERENCE:
+		AesBlockFunc = AesReferenceEncryptBlock;
+		AesExpandFunc = AesSoftwareExpandKey;
+		break;
+	case AES_ENGINE_AESNI:
+		AesBlockFunc = AesNiEncryptBlock;
+		AesExpandFunc = AesNiExpandKey;
+		break;
+	case AES_ENGINE_BITSLICE:
+		AesBlockFunc = AesBitsliceEncryptBlock;
+		AesExpandFunc = AesBitsliceExpandKey;
+		break;
+	case AES_ENGINE_TTABLE:
+	default:
+		Engine = AES_ENGINE_TTABLE;
+		AesBlockFunc = AesTTableEncryptBlock;
+		AesExpandFunc = AesSoftwareExpandKey;
+		break;
+	}
+	AesEngine = Engine;
+}
+
+// The pointers above are constant initialised to the T-table engine, so
+// code running in other files' static initialisers always finds a working
+// engine. CPUID is then checked once, from this file's dynamic
+// initialisation, and AES-NI is selected when present.
+static int AesSelectDefaultEngine(void)
+{
+	AesSetEngine(AES_ENGINE_AESNI);
+	return 1;
+}
+
+static int AesEngineSelected = AesSelectDefaultEngine();
+
+AES_ENGINE AesGetEngine(void)
+{
+	return AesEngine;
+}
+
+// This function expands a 128, 192 or 256 bit key into its round keys.
+// The result is only read by the cipher, so one expanded key may be
+// shared by any number of threads and reused for any number of blocks.
+void AesExpandKey(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	)
+{
+	AesExpandFunc(KeyLen, pKey, pExpandedKey);
+}
+
+// The same round keys written to a bare 16 * (Nr + 1) byte schedule, for
+// callers such as AES<KeyBits> that know Nr and keep no AES_EXPANDED_KEY.
+void AesExpandRoundKeys(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	const unsigned char *pKey,
+	unsigned char *pRoundKey
+	)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+	int Nk = KeyLen / 32;
+
+	if (KeyLen != 128 && KeyLen != 192 && KeyLen != 256) return;
+	switch (AesEngine)
 	{
-		Key[i]=pKey[i];
-		in[i]=pPlainTextData[i];
+	case AES_ENGINE_AESNI:
+		AesNiExpandRoundKeys(KeyLen, pKey, pRoundKey);
+		break;
+	case AES_ENGINE_BITSLICE:
+		// Keep the bitsliced engine's S-box free expansion
+		AesBitsliceExpandKey(KeyLen, (unsigned char *)pKey, &ExpandedKey);
+		memcpy(pRoundKey, ExpandedKey.RoundKey, 16 * (ExpandedKey.Nr + 1));
+		SecureWipe(&ExpandedKey, sizeof(ExpandedKey));
+		break;
+	default:
+		KeyExpansion(pRoundKey, Nk, Nk + 6, pKey);
+		break;
 	}
+}
+
+// Encrypt one 16 byte block with a key prepared by AesExpandKey.
+void AesEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	AesBlockFunc(pExpandedKey, pPlainTextData, pEncryptedData);
+}
+
+// Encrypt Count unrelated blocks, each under its own expanded key. With
+// AES-NI the blocks are interleaved round by round across several lanes.
+// The bitsliced engine slices the key once for each run of neighbouring
+// blocks under the same key and encrypts the run in full width passes;
+// the other portable engines encrypt the blocks one after another.
+void AesEncryptBlocks(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	unsigned char *pPlainTextData,	// Count * 16 bytes
+	unsigned char *pEncryptedData,	// Count * 16 bytes
+	int Count
+	)
+{
+	AES_BITSLICE_KEY BitsliceKey;
+	int i, run;
 
-	// The KeyExpansion routine must be called before encryption.
-	KeyExpansion();
+	if (AesEngine == AES_ENGINE_AESNI)
+	{
+		AesNiEncryptBlocks(ppExpandedKeys, pPlainTextData, pEncryptedData, Count);
+		return;
+	}
+	if (AesEngine == AES_ENGINE_BITSLICE)
+	{
+		for (i = 0; i < Count; i += run)
+		{
+			for (run = 1; i + run < Count && ppExpandedKeys[i + run] == ppExpandedKeys[i]; run++);
+			AesBitsliceKeyFromExpanded(ppExpandedKeys[i], &BitsliceKey);
+			AesBitsliceEncrypt(&BitsliceKey, pPlainTextData + 16 * i, pEncryptedData + 16 * i, run);
+		}
+		SecureWipe(&BitsliceKey, sizeof(BitsliceKey));
+		return;
+	}
+	for (i = 0; i < Count; i++)
+	{
+		AesBlockFunc(ppExpandedKeys[i], pPlainTextData + 16 * i, pEncryptedData + 16 * i);
+	}
+}
 
-	// The next function call encrypts the PlainText with the Key using AES algorithm.
-	Cipher();
+int AesKeyTableInit(
+	AES_KEY_TABLE *pTable,
+	int Capacity
+	)
+{
+	pTable->RoundKeys = (unsigned char *)AlignedAlloc((size_t)AES_KEY_TABLE_ROUNDS * Capacity * 16, 64);
+	pTable->Count = 0;
+	pTable->Capacity = pTable->RoundKeys ? Capacity : 0;
+	return pTable->RoundKeys != NULL;
+}
 
-	// Output the encrypted text.
-	for(i=0;i<Nb*4;i++)
+void AesKeyTableFree(
+	AES_KEY_TABLE *pTable
+	)
+{
+	if (pTable->RoundKeys)
 	{
-		pEncryptedData[i] = out[i];
+		SecureWipe(pTable->RoundKeys, (size_t)AES_KEY_TABLE_ROUNDS * pTable->Capacity * 16);
+		AlignedFree(pTable->RoundKeys);
 	}
+	pTable->RoundKeys = NULL;
+	pTable->Count = pTable->Capacity = 0;
 }
 
+// Expand Count keys into a table. The AES-NI path runs several key
+// schedules at once; the portable engines expand one key at a time and
+// scatter its round keys.
+int AesKeyTableAdd(
+	AES_KEY_TABLE *pTable,
+	const unsigned char (*pKeys)[16],
+	int Count
+	)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+	unsigned char key[16];
+	int first = pTable->Count;
+	int i, r;
+
+	if (Count < 0 || Count > pTable->Capacity - pTable->Count) return -1;
+
+	if (AesEngine == AES_ENGINE_AESNI)
+	{
+		AesNiExpandKeysTable(pTable, first, pKeys, Count);
+	}
+	else
+	{
+		for (i = 0; i < Count; i++)
+		{
+			memcpy(key, pKeys[i], 16);
+			AesExpandFunc(128, key, &ExpandedKey);
+			for (r = 0; r < AES_KEY_TABLE_ROUNDS; r++)
+			{
+				memcpy(pTable->RoundKeys + 16 * ((size_t)r * pTable->Capacity + first + i), ExpandedKey.RoundKey + 16 * r, 16);
+			}
+		}
+		SecureWipe(&ExpandedKey, sizeof(ExpandedKey));
+		SecureWipe(key, sizeof(key));
+	}
+	pTable->Count += Count;
+	return first;
+}
+
+void AesEncryptBlocksTable(
+	const AES_KEY_TABLE *pTable,
+	const int *pIndex,
+	unsigned char *pPlainTextData,	// Count * 16 bytes
+	unsigned char *pEncryptedData,	// Count * 16 bytes
+	int Count
+	)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+	AES_BITSLICE_KEY BitsliceKey;
+	int i, r, run;
+
+	if (AesEngine == AES_ENGINE_AESNI)
+	{
+		AesNiEncryptBlocksTable(pTable, pIndex, pPlainTextData, pEncryptedData, Count);
+		return;
+	}
+
+	// Portable engines want one schedule per block, or per run of blocks
+	// under the same key for the bitsliced engine: gather it
+	ExpandedKey.Nr = 10;
+	for (i = 0; i < Count; i += run)
+	{
+		run = 1;
+		if (AesEngine == AES_ENGINE_BITSLICE)
+		{
+			while (i + run < Count && pIndex[i + run] == pIndex[i]) run++;
+		}
+		for (r = 0; r < AES_KEY_TABLE_ROUNDS; r++)
+		{
+			memcpy(ExpandedKey.RoundKey + 16 * r, pTable->RoundKeys + 16 * ((size_t)r * pTable->Capacity + pIndex[i]), 16);
+		}
+		if (AesEngine == AES_ENGINE_BITSLICE)
+		{
+			AesBitsliceKeyFromExpanded(&ExpandedKey, &BitsliceKey);
+			AesBitsliceEncrypt(&BitsliceKey, pPlainTextData + 16 * i, pEncryptedData + 16 * i, run);
+		}
+		else
+		{
+			AesBlockFunc(&ExpandedKey, pPlainTextData + 16 * i, pEncryptedData + 16 * i);
+		}
+	}
+	SecureWipe(&ExpandedKey, sizeof(ExpandedKey));
+	SecureWipe(&BitsliceKey, sizeof(BitsliceKey));
+}
+
+// Prepare a caller owned context for the given key.
+void AesContextInit(
+	AES_CTX *ctx,
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	unsigned char *pKey
+	)
+{
+	AesExpandKey(KeyLen, pKey, &ctx->Key);
+}
+
+// Encrypt one 16 byte block with a context prepared by AesContextInit.
+// The context is only read, so callers holding different contexts (or
+// sharing one) may encrypt concurrently.
+void AesContextEncrypt(
+	AES_CTX *ctx,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	AesEncryptBlock(&ctx->Key, pPlainTextData, pEncryptedData);
+}
+
+void AesEncrypt(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	unsigned char *pKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+
+	AesExpandKey(KeyLen, pKey, &ExpandedKey);
+	AesEncryptBlock(&ExpandedKey, pPlainTextData, pEncryptedData);
+}
+
+
+void AES_128_ExpandKey(
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+)
+{
+	AesExpandKey(128, pKey, pExpandedKey);
+}
 
 void AES_128(
 	unsigned char *pKey,
@@ -332,7 +618,17 @@ void AES_128(
 	unsigned char *pEncryptedData
 )
 {
-	AesEncrypt(128, pKey, pPlainTextData, pEncryptedData);
+	AES<128>::Encrypt(pKey, pPlainTextData, pEncryptedData);
+}
+
+void AES_128_Batch(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+)
+{
+	AesEncryptBlocks(ppExpandedKeys, pPlainTextData, pEncryptedData, Count);
 }
 
 void AES_192(
@@ -341,7 +637,7 @@ void AES_192(
 	unsigned char *pEncryptedData
 )
 {
-	AesEncrypt(192, pKey, pPlainTextData, pEncryptedData);
+	AES<192>::Encrypt(pKey, pPlainTextData, pEncryptedData);
 }
 
 void AES_256(
@@ -350,7 +646,7 @@ void AES_256(
 	unsigned char *pEncryptedData
 )
 {
-	AesEncrypt(256, pKey, pPlainTextData, pEncryptedData);
+	AES<256>::Encrypt(pKey, pPlainTextData, pEncryptedData);
 }
 
 /************************************************************************************/
@@ -361,6 +657,12 @@ void AES_256(
 	KEY			000102030405060708090a0b0c0d0e0f
 
 	ENCRYPT		69c4e0d86a7b0430d8cdb78070b4c55a
+
+	KEY			000102030405060708090a0b0c0d0e0f1011121314151617
+	ENCRYPT		dda97ca4864cdfe06eaf70a0ec0d7191
+
+	KEY			000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f
+	ENCRYPT		8ea2b7ca516745bfeafc49904b496089
 */
 void AES_128_Test(void)
 {
@@ -375,5 +677,90 @@ void AES_128_Test(void)
 	printf("Raw Data       "); print128(plainData); printf("\n");
 	AesEncrypt(128, key, plainData, out);
 	printf("\nAES_128        "); print128(out); printf("\n");
+
+	AES_ENGINE engine = AesGetEngine();
+	AesSetEngine(AES_ENGINE_REFERENCE);
+	AesEncrypt(128, key, plainData, out);
+	printf("  (reference)  "); print128(out); printf("\n");
+	AesSetEngine(AES_ENGINE_TTABLE);
+	AesEncrypt(128, key, plainData, out);
+	printf("  (T-table)    "); print128(out); printf("\n");
+	AesSetEngine(AES_ENGINE_BITSLICE);
+	AesEncrypt(128, key, plainData, out);
+	printf("  (bitslice)   "); print128(out); printf("\n");
+	AesSetEngine(AES_ENGINE_AESNI);
+	if (AesGetEngine() == AES_ENGINE_AESNI)
+	{
+		AesEncrypt(128, key, plainData, out);
+		printf("  (AES-NI)     "); print128(out); printf("\n");
+	}
+	AesSetEngine(engine);
+
+	// 11 lanes: one full interleaved group of 8 plus a scalar tail
+	AES_EXPANDED_KEY expanded;
+	const AES_EXPANDED_KEY *keys[11];
+	unsigned char blocks[11 * 16];
+	AES_128_ExpandKey(key, &expanded);
+	for (int i = 0; i < 11; i++)
+	{
+		keys[i] = &expanded;
+		memcpy(blocks + 16 * i, plainData, 16);
+	}
+	AES_128_Batch(keys, blocks, blocks, 11);
+	printf("AES_128_Batch  "); print128(blocks + 16 * 10); printf("\n");
+
+	// 13 keys expanded in bulk (groups of 4 plus a tail) under every engine;
+	// each schedule must equal AesExpandKey's and key 9, the FIPS key, must
+	// encrypt to the same block as above.
+	AES_KEY_TABLE table;
+	unsigned char table_keys[13][16];
+	int index[11], mismatch = 0;
+	for (int i = 0; i < 13; i++)
+	{
+		for (int j = 0; j < 16; j++) table_keys[i][j] = (unsigned char)(i * 29 + j * 7);
+	}
+	memcpy(table_keys[9], key, 16);
+	for (int e = AES_ENGINE_REFERENCE; e <= AES_ENGINE_BITSLICE; e++)
+	{
+		AesSetEngine((AES_ENGINE)e);
+		AesKeyTableInit(&table, 16);
+		AesKeyTableAdd(&table, table_keys, 13);
+		for (int i = 0; i < 13; i++)
+		{
+			AES_128_ExpandKey(table_keys[i], &expanded);
+			for (int r = 0; r < AES_KEY_TABLE_ROUNDS; r++)
+			{
+				mismatch += memcmp(table.RoundKeys + 16 * (r * table.Capacity + i), expanded.RoundKey + 16 * r, 16) != 0;
+			}
+		}
+		for (int i = 0; i < 11; i++)
+		{
+			index[i] = i == 10 ? 9 : i;
+			memcpy(blocks + 16 * i, plainData, 16);
+		}
+		AesEncryptBlocksTable(&table, index, blocks, blocks, 11);
+		mismatch += memcmp(blocks + 16 * 10, out, 16) != 0;
+		AesKeyTableFree(&table);
+
+		// one run of 11 blocks under the FIPS key (a full bitsliced pass and a tail)
+		AES_128_ExpandKey(key, &expanded);
+		for (int i = 0; i < 11; i++) memcpy(blocks + 16 * i, plainData, 16);
+		AES_128_Batch(keys, blocks, blocks, 11);
+		for (int i = 0; i < 11; i++) mismatch += memcmp(blocks + 16 * i, out, 16) != 0;
+	}
+	AesSetEngine(engine);
+	printf("AesKeyTable    "); print128(blocks + 16 * 10); printf("\n");
+	printf("  all engines  %s\n", mismatch == 0 ? "match" : "MISMATCH");
+	printf("--------------------------------------------------\n");
+
+	// FIPS-197 C.2 and C.3, same plaintext with 192 and 256 bit keys
+	unsigned char key256[32];
+	for (int i = 0; i < 32; i++) key256[i] = (unsigned char)i;
+	printf("K              "); printBytes(key256, 24); printf("\n");
+	AES_192(key256, plainData, out);
+	printf("AES_192        "); print128(out); printf("\n");
+	printf("K              "); printBytes(key256, 32); printf("\n");
+	AES_256(key256, plainData, out);
+	printf("AES_256        "); print128(out); printf("\n");
 	printf("--------------------------------------------------\n");
 }
\ No newline at end of file
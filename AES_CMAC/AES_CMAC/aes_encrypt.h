@@ -1,6 +1,128 @@
 #ifndef __AES_ENCRYPT_H
 #define __AES_ENCRYPT_H
 
+#if defined(_MSC_VER)
+#define AES_ALIGN(n) __declspec(align(n))
+#else
+#define AES_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+// Expanded AES key. Built once by AesExpandKey and treated as opaque by
+// callers; the cipher only reads it, so it may be shared between threads.
+// The round keys come first so each one sits on a 16 byte boundary.
+typedef struct AES_ALIGN(16) _AES_EXPANDED_KEY
+{
+	unsigned char RoundKey[240];	// expanded key schedule
+	int Nr;							// number of rounds
+} AES_EXPANDED_KEY;
+
+// Per caller AES context. The cipher keeps its intermediate state on the
+// stack, so two threads using different contexts never share data.
+typedef struct _AES_CTX
+{
+	AES_EXPANDED_KEY Key;			// expanded key schedule
+} AES_CTX;
+
+// Many AES-128 keys expanded in bulk, structure of arrays: round r of key
+// k is at RoundKeys + 16 * (r * Capacity + k), so the same round of
+// consecutive keys is contiguous and lanes running neighbouring keys read
+// neighbouring bytes.
+#define AES_KEY_TABLE_ROUNDS	11
+
+typedef struct _AES_KEY_TABLE
+{
+	unsigned char *RoundKeys;		// AES_KEY_TABLE_ROUNDS * Capacity * 16 bytes, 64 byte aligned
+	int Count;						// keys in use
+	int Capacity;					// keys allocated
+} AES_KEY_TABLE;
+
+// Software engines selectable with AesSetEngine
+typedef enum _AES_ENGINE
+{
+	AES_ENGINE_REFERENCE,			// byte wise state matrix (FIPS-197 text)
+	AES_ENGINE_TTABLE,				// combined 32 bit lookup tables
+	AES_ENGINE_AESNI,				// AES-NI instructions (default when the CPU has them)
+	AES_ENGINE_BITSLICE				// constant time bitsliced cipher, no secret indexed lookups
+} AES_ENGINE;
+
+// Not synchronised: switch engines only while no other thread uses AES
+// (before the pipeline, pool or audit threads start, or after they stop).
+void AesSetEngine(AES_ENGINE Engine);
+AES_ENGINE AesGetEngine(void);
+
+// Expanded key AES Encrypt
+void AesExpandKey(
+	unsigned long KeyLen,
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	);
+
+// Expanded key without the AES_EXPANDED_KEY wrapper: 16 * (KeyLen / 32 + 7)
+// bytes of round keys, laid out as in AES_EXPANDED_KEY
+void AesExpandRoundKeys(
+	unsigned long KeyLen,
+	const unsigned char *pKey,
+	unsigned char *pRoundKey
+	);
+
+void AesEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+// Multi-key AES Encrypt: block i is encrypted under ppExpandedKeys[i]
+void AesEncryptBlocks(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	);
+
+void AES_128_ExpandKey(
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	);
+
+// Bulk AES-128 key expansion into a round key table
+int AesKeyTableInit(
+	AES_KEY_TABLE *pTable,
+	int Capacity
+	);
+
+void AesKeyTableFree(
+	AES_KEY_TABLE *pTable
+	);
+
+// Expand and append Count keys; returns the index of the first one, or -1
+// when the table has no room for all of them
+int AesKeyTableAdd(
+	AES_KEY_TABLE *pTable,
+	const unsigned char (*pKeys)[16],
+	int Count
+	);
+
+// Block i is encrypted under key pIndex[i] of the table
+void AesEncryptBlocksTable(
+	const AES_KEY_TABLE *pTable,
+	const int *pIndex,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	);
+
+// Reentrant AES Encrypt
+void AesContextInit(
+	AES_CTX *ctx,
+	unsigned long KeyLen,
+	unsigned char *pKey
+	);
+
+void AesContextEncrypt(
+	AES_CTX *ctx,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
 
 // AES Encrypt
 void AesEncrypt(
@@ -16,6 +138,25 @@ void AES_128(
 	unsigned char *pEncryptedData
 	);
 
+void AES_192(
+	unsigned char *pKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+void AES_256(
+	unsigned char *pKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+void AES_128_Batch(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	);
+
 void AES_128_Test(void);
 
-#endif
\ No newline at end of file
+#endif
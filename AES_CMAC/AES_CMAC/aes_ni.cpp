@@ -0,0 +1,556 @@
+/****************************************************************/
+/* AES encryption with the AES-NI instruction set               */
+/* Key expansion uses AESKEYGENASSIST, every round is a single  */
+/* AESENC and the last one AESENCLAST. The round keys are laid  */
+/* out exactly like the portable KeyExpansion() output, so an   */
+/* AES_EXPANDED_KEY can be used by any engine.                  */
+/****************************************************************/
+#include "stdafx.h"
+#include "aes_encrypt.h"
+#include "aes_ni.h"
+#include "aes_ttable.h"
+#include "crypto_helper.h"
+
+#if AES_NI_AVAILABLE
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// CPUID.01H:ECX.AES[bit 25] and ECX.SSSE3[bit 9]
+int AesNiSupported(void)
+{
+	unsigned int ecx;
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	ecx = (unsigned int)info[2];
+#else
+	unsigned int eax, ebx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+#endif
+	return ((ecx >> 25) & 1) && ((ecx >> 9) & 1);
+}
+
+// Only the kernels below may use AES and SSSE3; the probe above runs
+// before anyone knows they exist
+#if !defined(_MSC_VER)
+#pragma GCC push_options
+#pragma GCC target("aes,sse2,ssse3")
+#endif
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+
+/* Fold the previous round key into the AESKEYGENASSIST result */
+static inline void KEY_128_ASSIST(__m128i *temp1, __m128i *temp2)
+{
+	__m128i temp3;
+	*temp2 = _mm_shuffle_epi32(*temp2, 0xff);
+	temp3 = _mm_slli_si128(*temp1, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp3);
+	temp3 = _mm_slli_si128(temp3, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp3);
+	temp3 = _mm_slli_si128(temp3, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp3);
+	*temp1 = _mm_xor_si128(*temp1, *temp2);
+}
+
+static inline void KEY_192_ASSIST(__m128i *temp1, __m128i *temp2, __m128i *temp3)
+{
+	__m128i temp4;
+	*temp2 = _mm_shuffle_epi32(*temp2, 0x55);
+	temp4 = _mm_slli_si128(*temp1, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp1 = _mm_xor_si128(*temp1, temp4);
+	*temp1 = _mm_xor_si128(*temp1, *temp2);
+	*temp2 = _mm_shuffle_epi32(*temp1, 0xff);
+	temp4 = _mm_slli_si128(*temp3, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	*temp3 = _mm_xor_si128(*temp3, *temp2);
+}
+
+static inline void KEY_256_ASSIST_2(__m128i *temp1, __m128i *temp3)
+{
+	__m128i temp2, temp4;
+	temp4 = _mm_aeskeygenassist_si128(*temp1, 0x0);
+	temp2 = _mm_shuffle_epi32(temp4, 0xaa);
+	temp4 = _mm_slli_si128(*temp3, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	temp4 = _mm_slli_si128(temp4, 0x4);
+	*temp3 = _mm_xor_si128(*temp3, temp4);
+	*temp3 = _mm_xor_si128(*temp3, temp2);
+}
+
+/* AESKEYGENASSIST needs the round constant as an immediate, hence the macros */
+#define EXPAND_128(rk, i, rcon) \
+	temp2 = _mm_aeskeygenassist_si128(temp1, rcon); \
+	KEY_128_ASSIST(&temp1, &temp2); \
+	_mm_storeu_si128((__m128i *)((rk) + 16 * (i)), temp1);
+
+/* Every AES-192 step yields six words: four in temp1, two in the low half of temp3 */
+#define EXPAND_192(rk, i, rcon) \
+	temp2 = _mm_aeskeygenassist_si128(temp3, rcon); \
+	KEY_192_ASSIST(&temp1, &temp2, &temp3); \
+	_mm_storeu_si128((__m128i *)((rk) + 24 * (i)), temp1); \
+	if ((i) < 8) _mm_storel_epi64((__m128i *)((rk) + 24 * (i) + 16), temp3);
+
+#define EXPAND_256(rk, i, rcon) \
+	temp2 = _mm_aeskeygenassist_si128(temp3, rcon); \
+	KEY_128_ASSIST(&temp1, &temp2); \
+	_mm_storeu_si128((__m128i *)((rk) + 32 * (i)), temp1); \
+	if ((i) < 7) { \
+		KEY_256_ASSIST_2(&temp1, &temp3); \
+		_mm_storeu_si128((__m128i *)((rk) + 32 * (i) + 16), temp3); \
+	}
+
+void AesNiExpandRoundKeys(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	const unsigned char *pKey,
+	unsigned char *pRoundKey
+	)
+{
+	unsigned char *rk = pRoundKey;
+	__m128i temp1, temp2, temp3;
+
+	temp1 = _mm_loadu_si128((const __m128i *)pKey);
+	_mm_storeu_si128((__m128i *)rk, temp1);
+
+	switch (KeyLen)
+	{
+	case 192:
+		temp3 = _mm_loadl_epi64((const __m128i *)(pKey + 16));
+		_mm_storel_epi64((__m128i *)(rk + 16), temp3);
+		EXPAND_192(rk, 1, 0x01);
+		EXPAND_192(rk, 2, 0x02);
+		EXPAND_192(rk, 3, 0x04);
+		EXPAND_192(rk, 4, 0x08);
+		EXPAND_192(rk, 5, 0x10);
+		EXPAND_192(rk, 6, 0x20);
+		EXPAND_192(rk, 7, 0x40);
+		EXPAND_192(rk, 8, 0x80);
+		break;
+	case 256:
+		temp3 = _mm_loadu_si128((const __m128i *)(pKey + 16));
+		_mm_storeu_si128((__m128i *)(rk + 16), temp3);
+		EXPAND_256(rk, 1, 0x01);
+		EXPAND_256(rk, 2, 0x02);
+		EXPAND_256(rk, 3, 0x04);
+		EXPAND_256(rk, 4, 0x08);
+		EXPAND_256(rk, 5, 0x10);
+		EXPAND_256(rk, 6, 0x20);
+		EXPAND_256(rk, 7, 0x40);
+		break;
+	default:
+		EXPAND_128(rk, 1, 0x01);
+		EXPAND_128(rk, 2, 0x02);
+		EXPAND_128(rk, 3, 0x04);
+		EXPAND_128(rk, 4, 0x08);
+		EXPAND_128(rk, 5, 0x10);
+		EXPAND_128(rk, 6, 0x20);
+		EXPAND_128(rk, 7, 0x40);
+		EXPAND_128(rk, 8, 0x80);
+		EXPAND_128(rk, 9, 0x1b);
+		EXPAND_128(rk, 10, 0x36);
+		break;
+	}
+}
+
+void AesNiExpandKey(
+	unsigned long KeyLen,	// KeyLen = 128, 192, 256
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	)
+{
+	pExpandedKey->Nr = KeyLen == 256 ? 14 : KeyLen == 192 ? 12 : 10;
+	AesNiExpandRoundKeys(KeyLen, pKey, pExpandedKey->RoundKey);
+}
+
+void AesNiEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	const __m128i *rk = (const __m128i *)pExpandedKey->RoundKey;
+	__m128i m;
+	int round;
+
+	m = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pPlainTextData), _mm_loadu_si128(rk));
+	for (round = 1; round < pExpandedKey->Nr; round++)
+	{
+		m = _mm_aesenc_si128(m, _mm_loadu_si128(rk + round));
+	}
+	m = _mm_aesenclast_si128(m, _mm_loadu_si128(rk + pExpandedKey->Nr));
+	_mm_storeu_si128((__m128i *)pEncryptedData, m);
+}
+
+// Same rounds with Nr fixed at compile time, every AESENC written out.
+#define AESNI_ROUND(r) m = _mm_aesenc_si128(m, _mm_loadu_si128(rk + (r)));
+
+template <int Nr>
+void AesNiEncryptFixed(
+	const unsigned char *pRoundKey,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	const __m128i *rk = (const __m128i *)pRoundKey;
+	__m128i m;
+
+	m = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pPlainTextData), _mm_loadu_si128(rk));
+	AESNI_ROUND(1) AESNI_ROUND(2) AESNI_ROUND(3)
+	AESNI_ROUND(4) AESNI_ROUND(5) AESNI_ROUND(6)
+	AESNI_ROUND(7) AESNI_ROUND(8) AESNI_ROUND(9)
+	if (Nr > 10)
+	{
+		AESNI_ROUND(10) AESNI_ROUND(11)
+	}
+	if (Nr > 12)
+	{
+		AESNI_ROUND(12) AESNI_ROUND(13)
+	}
+	m = _mm_aesenclast_si128(m, _mm_loadu_si128(rk + Nr));
+	_mm_storeu_si128((__m128i *)pEncryptedData, m);
+}
+
+/*
+* Independent (key, block) pairs. One AESENC has several cycles of
+* latency but can issue every cycle, so running a round across 8 (or 4,
+* or 2) unrelated blocks keeps the AES unit busy instead of waiting on one
+* block. The keys in a group must share the same number of rounds.
+*/
+#define LANE_LOAD(n) \
+	m##n = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pPlainTextData + 16 * n)), \
+		_mm_loadu_si128((const __m128i *)ppExpandedKeys[n]->RoundKey));
+#define LANE_ROUND(n) \
+	m##n = _mm_aesenc_si128(m##n, _mm_loadu_si128((const __m128i *)ppExpandedKeys[n]->RoundKey + round));
+#define LANE_LAST(n) \
+	m##n = _mm_aesenclast_si128(m##n, _mm_loadu_si128((const __m128i *)ppExpandedKeys[n]->RoundKey + Nr)); \
+	_mm_storeu_si128((__m128i *)(pEncryptedData + 16 * n), m##n);
+
+static void AesNiEncrypt8(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Nr
+	)
+{
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	int round;
+
+	LANE_LOAD(0) LANE_LOAD(1) LANE_LOAD(2) LANE_LOAD(3)
+	LANE_LOAD(4) LANE_LOAD(5) LANE_LOAD(6) LANE_LOAD(7)
+	for (round = 1; round < Nr; round++)
+	{
+		LANE_ROUND(0) LANE_ROUND(1) LANE_ROUND(2) LANE_ROUND(3)
+		LANE_ROUND(4) LANE_ROUND(5) LANE_ROUND(6) LANE_ROUND(7)
+	}
+	LANE_LAST(0) LANE_LAST(1) LANE_LAST(2) LANE_LAST(3)
+	LANE_LAST(4) LANE_LAST(5) LANE_LAST(6) LANE_LAST(7)
+}
+
+static void AesNiEncrypt4(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Nr
+	)
+{
+	__m128i m0, m1, m2, m3;
+	int round;
+
+	LANE_LOAD(0) LANE_LOAD(1) LANE_LOAD(2) LANE_LOAD(3)
+	for (round = 1; round < Nr; round++)
+	{
+		LANE_ROUND(0) LANE_ROUND(1) LANE_ROUND(2) LANE_ROUND(3)
+	}
+	LANE_LAST(0) LANE_LAST(1) LANE_LAST(2) LANE_LAST(3)
+}
+
+// Two chains, e.g. the MacKey/LTK pair of f5 or Ea/Eb of f6
+static void AesNiEncrypt2(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Nr
+	)
+{
+	__m128i m0, m1;
+	int round;
+
+	LANE_LOAD(0) LANE_LOAD(1)
+	for (round = 1; round < Nr; round++)
+	{
+		LANE_ROUND(0) LANE_ROUND(1)
+	}
+	LANE_LAST(0) LANE_LAST(1)
+}
+
+/* Nonzero when all n keys have the same number of rounds */
+static int SameRounds(const AES_EXPANDED_KEY *const *ppExpandedKeys, int n)
+{
+	int i;
+	for (i = 1; i < n; i++)
+	{
+		if (ppExpandedKeys[i]->Nr != ppExpandedKeys[0]->Nr) return 0;
+	}
+	return 1;
+}
+
+void AesNiEncryptBlocks(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	)
+{
+	int i = 0, n;
+
+	while (i < Count)
+	{
+		n = Count - i;
+		if (n >= 8 && SameRounds(ppExpandedKeys + i, 8))
+		{
+			AesNiEncrypt8(ppExpandedKeys + i, pPlainTextData + 16 * i, pEncryptedData + 16 * i, ppExpandedKeys[i]->Nr);
+			i += 8;
+		}
+		else if (n >= 4 && SameRounds(ppExpandedKeys + i, 4))
+		{
+			AesNiEncrypt4(ppExpandedKeys + i, pPlainTextData + 16 * i, pEncryptedData + 16 * i, ppExpandedKeys[i]->Nr);
+			i += 4;
+		}
+		else if (n >= 2 && SameRounds(ppExpandedKeys + i, 2))
+		{
+			AesNiEncrypt2(ppExpandedKeys + i, pPlainTextData + 16 * i, pEncryptedData + 16 * i, ppExpandedKeys[i]->Nr);
+			i += 2;
+		}
+		else
+		{
+			// scalar tail, or a group mixing key sizes
+			AesNiEncryptBlock(ppExpandedKeys[i], pPlainTextData + 16 * i, pEncryptedData + 16 * i);
+			i++;
+		}
+	}
+}
+
+/*
+* Bulk AES-128 expansion into a key table. AESKEYGENASSIST issues slowly
+* on most cores, so RotWord/SubWord come from AESENCLAST instead: with the
+* rotated last word broadcast to all four columns ShiftRows changes
+* nothing, and the round constant goes in as the round key. The constant
+* is then an ordinary register, and four keys are expanded side by side.
+*/
+static inline __m128i ExpandStep128(__m128i k, __m128i con)
+{
+	__m128i t = _mm_shuffle_epi8(k, _mm_set1_epi32(0x0c0f0e0d));	// RotWord(w3) in every column
+	t = _mm_aesenclast_si128(t, con);
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 8));
+	return _mm_xor_si128(k, t);
+}
+
+// rcon for round r + 1: doubling in GF(2^8), 0x80 -> 0x1b
+static inline __m128i NextRcon(__m128i con, int round)
+{
+	return round == 8 ? _mm_set1_epi32(0x1b) : _mm_slli_epi32(con, 1);
+}
+
+#define TABLE_STORE(n) _mm_storeu_si128((__m128i *)(rk + stride * round + 16 * n), k##n);
+#define TABLE_STEP(n) k##n = ExpandStep128(k##n, con);
+
+void AesNiExpandKeysTable(
+	AES_KEY_TABLE *pTable,
+	int First,
+	const unsigned char (*pKeys)[16],
+	int Count
+	)
+{
+	size_t stride = 16 * (size_t)pTable->Capacity;
+	unsigned char *rk;
+	__m128i k0, k1, k2, k3, con;
+	int i, round;
+
+	for (i = 0; i + 4 <= Count; i += 4)
+	{
+		rk = pTable->RoundKeys + 16 * (size_t)(First + i);
+		k0 = _mm_loadu_si128((const __m128i *)pKeys[i]);
+		k1 = _mm_loadu_si128((const __m128i *)pKeys[i + 1]);
+		k2 = _mm_loadu_si128((const __m128i *)pKeys[i + 2]);
+		k3 = _mm_loadu_si128((const __m128i *)pKeys[i + 3]);
+		round = 0;
+		TABLE_STORE(0) TABLE_STORE(1) TABLE_STORE(2) TABLE_STORE(3)
+		con = _mm_set1_epi32(0x01);
+		for (round = 1; round < AES_KEY_TABLE_ROUNDS; round++)
+		{
+			TABLE_STEP(0) TABLE_STEP(1) TABLE_STEP(2) TABLE_STEP(3)
+			TABLE_STORE(0) TABLE_STORE(1) TABLE_STORE(2) TABLE_STORE(3)
+			con = NextRcon(con, round);
+		}
+	}
+	for (; i < Count; i++)
+	{
+		rk = pTable->RoundKeys + 16 * (size_t)(First + i);
+		k0 = _mm_loadu_si128((const __m128i *)pKeys[i]);
+		round = 0;
+		TABLE_STORE(0)
+		con = _mm_set1_epi32(0x01);
+		for (round = 1; round < AES_KEY_TABLE_ROUNDS; round++)
+		{
+			TABLE_STEP(0)
+			TABLE_STORE(0)
+			con = NextRcon(con, round);
+		}
+	}
+}
+
+/* Lanes reading their round keys from a key table by index */
+#define TLANE_LOAD(n) \
+	p##n = pTable->RoundKeys + 16 * (size_t)pIndex[n]; \
+	m##n = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pPlainTextData + 16 * n)), \
+		_mm_loadu_si128((const __m128i *)p##n));
+#define TLANE_ROUND(n) \
+	m##n = _mm_aesenc_si128(m##n, _mm_loadu_si128((const __m128i *)(p##n + stride * round)));
+#define TLANE_LAST(n) \
+	m##n = _mm_aesenclast_si128(m##n, _mm_loadu_si128((const __m128i *)(p##n + stride * 10))); \
+	_mm_storeu_si128((__m128i *)(pEncryptedData + 16 * n), m##n);
+
+static void AesNiEncryptTable8(
+	const AES_KEY_TABLE *pTable,
+	const int *pIndex,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	size_t stride = 16 * (size_t)pTable->Capacity;
+	const unsigned char *p0, *p1, *p2, *p3, *p4, *p5, *p6, *p7;
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	int round;
+
+	TLANE_LOAD(0) TLANE_LOAD(1) TLANE_LOAD(2) TLANE_LOAD(3)
+	TLANE_LOAD(4) TLANE_LOAD(5) TLANE_LOAD(6) TLANE_LOAD(7)
+	for (round = 1; round < 10; round++)
+	{
+		TLANE_ROUND(0) TLANE_ROUND(1) TLANE_ROUND(2) TLANE_ROUND(3)
+		TLANE_ROUND(4) TLANE_ROUND(5) TLANE_ROUND(6) TLANE_ROUND(7)
+	}
+	TLANE_LAST(0) TLANE_LAST(1) TLANE_LAST(2) TLANE_LAST(3)
+	TLANE_LAST(4) TLANE_LAST(5) TLANE_LAST(6) TLANE_LAST(7)
+}
+
+static void AesNiEncryptTable1(
+	const AES_KEY_TABLE *pTable,
+	const int *pIndex,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	size_t stride = 16 * (size_t)pTable->Capacity;
+	const unsigned char *p0;
+	__m128i m0;
+	int round;
+
+	TLANE_LOAD(0)
+	for (round = 1; round < 10; round++)
+	{
+		TLANE_ROUND(0)
+	}
+	TLANE_LAST(0)
+}
+
+void AesNiEncryptBlocksTable(
+	const AES_KEY_TABLE *pTable,
+	const int *pIndex,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	)
+{
+	int i = 0;
+
+	for (; i + 8 <= Count; i += 8)
+	{
+		AesNiEncryptTable8(pTable, pIndex + i, pPlainTextData + 16 * i, pEncryptedData + 16 * i);
+	}
+	for (; i < Count; i++)
+	{
+		AesNiEncryptTable1(pTable, pIndex + i, pPlainTextData + 16 * i, pEncryptedData + 16 * i);
+	}
+}
+
+template void AesNiEncryptFixed<10>(const unsigned char *, const unsigned char *, unsigned char *);
+template void AesNiEncryptFixed<12>(const unsigned char *, const unsigned char *, unsigned char *);
+template void AesNiEncryptFixed<14>(const unsigned char *, const unsigned char *, unsigned char *);
+
+#if !defined(_MSC_VER)
+#pragma GCC pop_options
+#endif
+
+#else /* !AES_NI_AVAILABLE */
+
+template <int Nr>
+void AesNiEncryptFixed(const unsigned char *pRoundKey, const unsigned char *pPlainTextData, unsigned char *pEncryptedData)
+{
+	AesTTableEncryptFixed<Nr>(pRoundKey, pPlainTextData, pEncryptedData);
+}
+
+int AesNiSupported(void)
+{
+	return 0;
+}
+
+void AesNiExpandKey(unsigned long KeyLen, unsigned char *pKey, AES_EXPANDED_KEY *pExpandedKey)
+{
+	AesExpandKey(KeyLen, pKey, pExpandedKey);
+}
+
+void AesNiExpandRoundKeys(unsigned long KeyLen, const unsigned char *pKey, unsigned char *pRoundKey)
+{
+	AesExpandRoundKeys(KeyLen, pKey, pRoundKey);
+}
+
+void AesNiEncryptBlock(const AES_EXPANDED_KEY *pExpandedKey, unsigned char *pPlainTextData, unsigned char *pEncryptedData)
+{
+	AesEncryptBlock(pExpandedKey, pPlainTextData, pEncryptedData);
+}
+
+void AesNiEncryptBlocks(const AES_EXPANDED_KEY *const *ppExpandedKeys, unsigned char *pPlainTextData, unsigned char *pEncryptedData, int Count)
+{
+	AesEncryptBlocks(ppExpandedKeys, pPlainTextData, pEncryptedData, Count);
+}
+
+void AesNiExpandKeysTable(AES_KEY_TABLE *pTable, int First, const unsigned char (*pKeys)[16], int Count)
+{
+	AES_EXPANDED_KEY ExpandedKey;
+	unsigned char key[16];
+	int i, r;
+
+	for (i = 0; i < Count; i++)
+	{
+		memcpy(key, pKeys[i], 16);
+		AesExpandKey(128, key, &ExpandedKey);
+		for (r = 0; r < AES_KEY_TABLE_ROUNDS; r++)
+		{
+			memcpy(pTable->RoundKeys + 16 * ((size_t)r * pTable->Capacity + First + i), ExpandedKey.RoundKey + 16 * r, 16);
+		}
+	}
+	SecureWipe(&ExpandedKey, sizeof(ExpandedKey));
+	SecureWipe(key, sizeof(key));
+}
+
+void AesNiEncryptBlocksTable(const AES_KEY_TABLE *pTable, const int *pIndex, unsigned char *pPlainTextData, unsigned char *pEncryptedData, int Count)
+{
+	AesEncryptBlocksTable(pTable, pIndex, pPlainTextData, pEncryptedData, Count);
+}
+
+template void AesNiEncryptFixed<10>(const unsigned char *, const unsigned char *, unsigned char *);
+template void AesNiEncryptFixed<12>(const unsigned char *, const unsigned char *, unsigned char *);
+template void AesNiEncryptFixed<14>(const unsigned char *, const unsigned char *, unsigned char *);
+
+#endif /* AES_NI_AVAILABLE */
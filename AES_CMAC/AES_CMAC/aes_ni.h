@@ -0,0 +1,70 @@
+#ifndef __AES_NI_H
+#define __AES_NI_H
+
+#include "aes_encrypt.h"
+
+// AES-NI can only be compiled for x86 and x64 targets
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define AES_NI_AVAILABLE 1
+#else
+#define AES_NI_AVAILABLE 0
+#endif
+
+// Nonzero when the CPU reports the AES instructions and SSSE3 (the key
+// table expansion uses PSHUFB)
+int AesNiSupported(void);
+
+// AES-NI AES Encrypt
+void AesNiExpandKey(
+	unsigned long KeyLen,
+	unsigned char *pKey,
+	AES_EXPANDED_KEY *pExpandedKey
+	);
+
+// Same schedule into a bare 16 * (Nr + 1) byte buffer
+void AesNiExpandRoundKeys(
+	unsigned long KeyLen,
+	const unsigned char *pKey,
+	unsigned char *pRoundKey
+	);
+
+void AesNiEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+// AES-NI AES Encrypt with Nr = 10, 12 or 14 fixed at compile time
+template <int Nr>
+void AesNiEncryptFixed(
+	const unsigned char *pRoundKey,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+void AesNiEncryptBlocks(
+	const AES_EXPANDED_KEY *const *ppExpandedKeys,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	);
+
+// Several AES-128 key schedules expanded side by side (SubWord through
+// AESENCLAST and PSHUFB rather than AESKEYGENASSIST), written to table
+// slots First..First+Count-1
+void AesNiExpandKeysTable(
+	AES_KEY_TABLE *pTable,
+	int First,
+	const unsigned char (*pKeys)[16],
+	int Count
+	);
+
+void AesNiEncryptBlocksTable(
+	const AES_KEY_TABLE *pTable,
+	const int *pIndex,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData,
+	int Count
+	);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef __AES_TEMPLATE_H
+#define __AES_TEMPLATE_H
+
+#include <string.h>
+#include "aes_encrypt.h"
+#include "aes_ttable.h"
+#include "aes_ni.h"
+
+/*
+* AES with the key size fixed at compile time.
+*
+*   AES<128>::Key key;
+*   AES<128>::ExpandKey(pKey, &key);
+*   AES<128>::Encrypt(&key, pPlainTextData, pEncryptedData);
+*
+* Nk, Nr and the size of the round key storage are constants of each
+* specialization, and the T-table and AES-NI block functions have every
+* round written out, so the hot path has no round counter. Keys are
+* expanded straight into the 16 * (Nr + 1) byte schedule. The engine is
+* still chosen at run time: one switch per call, the same as the other
+* entry points going through AesSetEngine's function pointers.
+*/
+template <int KeyBits> struct AesTraits;
+template <> struct AesTraits<128> { enum { Nk = 4, Nr = 10 }; };
+template <> struct AesTraits<192> { enum { Nk = 6, Nr = 12 }; };
+template <> struct AesTraits<256> { enum { Nk = 8, Nr = 14 }; };
+
+template <int KeyBits>
+struct AES_ALIGN(16) AesKey
+{
+	enum
+	{
+		Nk = AesTraits<KeyBits>::Nk,
+		Nr = AesTraits<KeyBits>::Nr,
+		ScheduleBytes = 16 * (AesTraits<KeyBits>::Nr + 1)
+	};
+	unsigned char RoundKey[ScheduleBytes];
+};
+
+template <int KeyBits>
+class AES
+{
+public:
+	typedef AesKey<KeyBits> Key;
+
+	enum
+	{
+		KeyBytes = KeyBits / 8,
+		Nr = AesTraits<KeyBits>::Nr
+	};
+
+	// Key expansion follows the engine selected with AesSetEngine.
+	static void ExpandKey(const unsigned char *pKey, Key *pExpandedKey)
+	{
+		AesExpandRoundKeys(KeyBits, pKey, pExpandedKey->RoundKey);
+	}
+
+	static void Encrypt(const Key *pExpandedKey, const unsigned char *pPlainTextData, unsigned char *pEncryptedData)
+	{
+		switch (AesGetEngine())
+		{
+		case AES_ENGINE_AESNI:
+			AesNiEncryptFixed<Nr>(pExpandedKey->RoundKey, pPlainTextData, pEncryptedData);
+			break;
+		case AES_ENGINE_TTABLE:
+			AesTTableEncryptFixed<Nr>(pExpandedKey->RoundKey, pPlainTextData, pEncryptedData);
+			break;
+		default:
+			EncryptGeneric(pExpandedKey, pPlainTextData, pEncryptedData);
+			break;
+		}
+	}
+
+	// One block under a raw key, as AES_128/AES_192/AES_256 do. The engine
+	// is looked at once for both the expansion and the rounds.
+	static void Encrypt(const unsigned char *pKey, const unsigned char *pPlainTextData, unsigned char *pEncryptedData)
+	{
+		Key key;
+
+		switch (AesGetEngine())
+		{
+		case AES_ENGINE_AESNI:
+			AesNiExpandRoundKeys(KeyBits, pKey, key.RoundKey);
+			AesNiEncryptFixed<Nr>(key.RoundKey, pPlainTextData, pEncryptedData);
+			break;
+		case AES_ENGINE_TTABLE:
+			AesExpandRoundKeys(KeyBits, pKey, key.RoundKey);
+			AesTTableEncryptFixed<Nr>(key.RoundKey, pPlainTextData, pEncryptedData);
+			break;
+		default:
+			// No fixed size variant: a single AES_EXPANDED_KEY, no copy
+			AesEncrypt(KeyBits, (unsigned char *)pKey, (unsigned char *)pPlainTextData, pEncryptedData);
+			break;
+		}
+	}
+
+private:
+	// Engines without a fixed size variant take the generic expanded key.
+	static void EncryptGeneric(const Key *pExpandedKey, const unsigned char *pPlainTextData, unsigned char *pEncryptedData)
+	{
+		AES_EXPANDED_KEY full;
+
+		memcpy(full.RoundKey, pExpandedKey->RoundKey, Key::ScheduleBytes);
+		full.Nr = Nr;
+		AesEncryptBlock(&full, (unsigned char *)pPlainTextData, pEncryptedData);
+	}
+};
+
+#endif
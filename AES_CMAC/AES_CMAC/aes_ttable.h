@@ -0,0 +1,28 @@
+#ifndef __AES_TTABLE_H
+#define __AES_TTABLE_H
+
+#include "aes_encrypt.h"
+
+// Combined SubBytes/ShiftRows/MixColumns lookup tables
+extern const unsigned int Te0[256];
+extern const unsigned int Te1[256];
+extern const unsigned int Te2[256];
+extern const unsigned int Te3[256];
+extern const unsigned char Te4[256];
+
+// T-table AES Encrypt
+void AesTTableEncryptBlock(
+	const AES_EXPANDED_KEY *pExpandedKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+// T-table AES Encrypt with Nr = 10, 12 or 14 fixed at compile time
+template <int Nr>
+void AesTTableEncryptFixed(
+	const unsigned char *pRoundKey,
+	const unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+#endif
@@ -0,0 +1,449 @@
+/****************************************************************/
+/* Memory mapped bond database                                  */
+/* Fixed size records plus, optionally, the expanded IRK and    */
+/* LTK schedules, laid out so that opening the file is one      */
+/* read only mapping: the IRK schedules section is used as the  */
+/* resolver's key table in place and LTK schedules feed e().    */
+/* The file holds long term secrets; keep it where only the     */
+/* host stack can read it.                                      */
+/****************************************************************/
+#include "stdafx.h"
+#include "ble_bond_db.h"
+#include "ble_rpa.h"
+#include "ble_smp_crypto.h"
+#include "crypto_helper.h"
+#if defined(_MSC_VER)
+#include <windows.h>
+#include <sddl.h>
+#pragma comment(lib, "advapi32.lib")
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define BT_BOND_DB_PAGE		4096
+
+// Largest file accepted: keeps every offset computation inside 32 bits
+#define BT_BOND_DB_MAX_SIZE	0x10000000
+
+static unsigned int PageAlign(unsigned int Offset)
+{
+	return (Offset + BT_BOND_DB_PAGE - 1) & ~(unsigned int)(BT_BOND_DB_PAGE - 1);
+}
+
+// Section offsets for Count records, IrkCount of them with an IRK
+static void Layout(BT_BOND_DB_HEADER *h, int Count, int IrkCount, int WithSchedules)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->Magic, BT_BOND_DB_MAGIC, 8);
+	h->Version = BT_BOND_DB_VERSION;
+	h->Flags = WithSchedules ? BT_BOND_DB_SCHEDULES : 0;
+	h->RecordSize = sizeof(BT_BOND_RECORD);
+	h->KeySize = sizeof(AES_EXPANDED_KEY);
+	h->Count = Count;
+	h->IrkCount = IrkCount;
+	h->RecordOffset = PageAlign(sizeof(BT_BOND_DB_HEADER));
+	h->IrkMapOffset = PageAlign(h->RecordOffset + Count * sizeof(BT_BOND_RECORD));
+	h->FileSize = PageAlign(h->IrkMapOffset + IrkCount * sizeof(unsigned int));
+	if (WithSchedules)
+	{
+		h->IrkKeyOffset = h->FileSize;
+		h->LtkKeyOffset = PageAlign(h->IrkKeyOffset + IrkCount * sizeof(AES_EXPANDED_KEY));
+		h->FileSize = PageAlign(h->LtkKeyOffset + Count * sizeof(AES_EXPANDED_KEY));
+	}
+}
+
+// Write Size bytes to a new file only the owner can open, then move it
+// over pPath, so a crash leaves either the old or the new database
+static int WriteImage(const char *pPath, const unsigned char *image, size_t Size)
+{
+	size_t len = strlen(pPath);
+	char *tmp = (char *)malloc(len + 5);
+	int ok = 0;
+
+	if (tmp == NULL) return 0;
+	memcpy(tmp, pPath, len);
+	memcpy(tmp + len, ".tmp", 5);
+#if defined(_MSC_VER)
+	{
+		// protected DACL: full access for the owner and SYSTEM only
+		SECURITY_ATTRIBUTES sa;
+		PSECURITY_DESCRIPTOR sd = NULL;
+		HANDLE f;
+		DWORD done;
+
+		if (ConvertStringSecurityDescriptorToSecurityDescriptorA("D:P(A;;FA;;;OW)(A;;FA;;;SY)", SDDL_REVISION_1, &sd, NULL))
+		{
+			sa.nLength = sizeof(sa);
+			sa.lpSecurityDescriptor = sd;
+			sa.bInheritHandle = FALSE;
+			DeleteFileA(tmp);							// left over from a crash
+			f = CreateFileA(tmp, GENERIC_WRITE, 0, &sa, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (f != INVALID_HANDLE_VALUE)
+			{
+				ok = WriteFile(f, image, (DWORD)Size, &done, NULL) && done == Size && FlushFileBuffers(f);
+				if (!CloseHandle(f)) ok = 0;
+				if (ok) ok = MoveFileExA(tmp, pPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+				if (!ok) DeleteFileA(tmp);
+			}
+			LocalFree(sd);
+		}
+	}
+#else
+	{
+		ssize_t n;
+		size_t done = 0;
+		int fd;
+
+		unlink(tmp);									// left over from a crash
+		fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0)
+		{
+			ok = 1;
+			while (ok && done < Size)
+			{
+				n = write(fd, image + done, Size - done);
+				if (n > 0) done += (size_t)n;
+				else if (n < 0 && errno == EINTR) continue;
+				else ok = 0;
+			}
+			if (ok && fsync(fd) != 0) ok = 0;
+			if (close(fd) != 0) ok = 0;
+			if (ok && rename(tmp, pPath) != 0) ok = 0;
+			if (!ok) unlink(tmp);
+		}
+	}
+#endif
+	free(tmp);
+	return ok;
+}
+
+int Bt_BondDbWrite(
+	const char *pPath,
+	const BT_BOND_RECORD *pRecords,
+	int Count,
+	int WithSchedules
+	)
+{
+	BT_BOND_DB_HEADER h;
+	unsigned char *image;
+	unsigned int *irk_map;
+	AES_EXPANDED_KEY *irk_keys, *ltk_keys;
+	int i, irks = 0, ok;
+
+	// Keep Layout's 32 bit offsets from wrapping, then apply Validate's limit
+	if (Count < 0) return 0;
+	if ((unsigned long long)Count * (sizeof(BT_BOND_RECORD) + sizeof(unsigned int) + 2 * sizeof(AES_EXPANDED_KEY)) > BT_BOND_DB_MAX_SIZE) return 0;
+	for (i = 0; i < Count; i++)
+	{
+		if (pRecords[i].Keys & BT_BOND_IRK) irks++;
+	}
+	Layout(&h, Count, irks, WithSchedules);
+	if (h.FileSize > BT_BOND_DB_MAX_SIZE) return 0;
+
+	// Build the image in memory; the schedules need 16 byte alignment
+	image = (unsigned char *)AlignedAlloc(h.FileSize, BT_BOND_DB_PAGE);
+	if (image == NULL) return 0;
+	memset(image, 0, h.FileSize);
+	memcpy(image, &h, sizeof(h));
+	memcpy(image + h.RecordOffset, pRecords, Count * sizeof(BT_BOND_RECORD));
+
+	irk_map = (unsigned int *)(image + h.IrkMapOffset);
+	irk_keys = (AES_EXPANDED_KEY *)(image + h.IrkKeyOffset);
+	ltk_keys = (AES_EXPANDED_KEY *)(image + h.LtkKeyOffset);
+	for (i = 0, irks = 0; i < Count; i++)
+	{
+		// the expansions only read the key; no stack copy of the record
+		if (pRecords[i].Keys & BT_BOND_IRK)
+		{
+			if (WithSchedules) AES_128_ExpandKey((unsigned char *)pRecords[i].Irk, &irk_keys[irks]);
+			irk_map[irks++] = i;
+		}
+		// schedule of a missing LTK stays zero; Bt_BondDbEncrypt refuses it
+		if (WithSchedules && (pRecords[i].Keys & BT_BOND_LTK)) AES_128_ExpandKey((unsigned char *)pRecords[i].Ltk, &ltk_keys[i]);
+		else if (WithSchedules) ltk_keys[i].Nr = 10;		// Validate wants Nr = 10 everywhere
+	}
+
+	ok = WriteImage(pPath, image, h.FileSize);
+
+	SecureWipe(image, h.FileSize);
+	AlignedFree(image);
+	return ok;
+}
+
+static void Unmap(BT_BOND_DB *pDb)
+{
+#if defined(_MSC_VER)
+	if (pDb->Base) UnmapViewOfFile(pDb->Base);
+	if (pDb->Mapping) CloseHandle((HANDLE)pDb->Mapping);
+	if (pDb->File) CloseHandle((HANDLE)pDb->File);
+#else
+	if (pDb->Base) munmap(pDb->Base, pDb->Size);
+	if (pDb->File) close((int)(intptr_t)pDb->File - 1);
+#endif
+	pDb->Base = pDb->File = pDb->Mapping = NULL;
+}
+
+static int Map(BT_BOND_DB *pDb, const char *pPath)
+{
+#if defined(_MSC_VER)
+	LARGE_INTEGER size;
+	HANDLE f = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (f == INVALID_HANDLE_VALUE) return 0;
+	pDb->File = f;
+	if (!GetFileSizeEx(f, &size) || size.QuadPart == 0 || size.HighPart != 0) return 0;
+	pDb->Size = (size_t)size.QuadPart;
+	pDb->Mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (pDb->Mapping == NULL) return 0;
+	pDb->Base = MapViewOfFile((HANDLE)pDb->Mapping, FILE_MAP_READ, 0, 0, 0);
+	return pDb->Base != NULL;
+#else
+	struct stat st;
+	void *base;
+	int fd = open(pPath, O_RDONLY);
+
+	if (fd < 0) return 0;
+	pDb->File = (void *)(intptr_t)(fd + 1);		// NULL stays "no file"
+	if (fstat(fd, &st) != 0 || st.st_size == 0) return 0;
+	pDb->Size = (size_t)st.st_size;
+	base = mmap(NULL, pDb->Size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) return 0;
+	pDb->Base = base;
+	return 1;
+#endif
+}
+
+// Every section inside the file, every IRK map entry a valid record and
+// every schedule an AES-128 one: the engines loop on Nr, so a schedule
+// from the file with a larger Nr would read past RoundKey
+static int Validate(const BT_BOND_DB_HEADER *h, size_t Size)
+{
+	BT_BOND_DB_HEADER expect;
+	const unsigned int *irk_map;
+	const AES_EXPANDED_KEY *keys;
+	unsigned int i;
+
+	if (Size < sizeof(*h) || Size > BT_BOND_DB_MAX_SIZE) return 0;
+	if (memcmp(h->Magic, BT_BOND_DB_MAGIC, 8) != 0) return 0;
+	if (h->Version != BT_BOND_DB_VERSION || h->FileSize != Size) return 0;
+	if (h->RecordSize != sizeof(BT_BOND_RECORD) || h->KeySize != sizeof(AES_EXPANDED_KEY)) return 0;
+	if (h->IrkCount > h->Count || h->Count > Size / sizeof(BT_BOND_RECORD)) return 0;
+
+	Layout(&expect, h->Count, h->IrkCount, (h->Flags & BT_BOND_DB_SCHEDULES) != 0);
+	if (memcmp(&expect, h, sizeof(expect)) != 0) return 0;
+
+	irk_map = (const unsigned int *)((const unsigned char *)h + h->IrkMapOffset);
+	for (i = 0; i < h->IrkCount; i++)
+	{
+		if (irk_map[i] >= h->Count) return 0;
+	}
+	if (!(h->Flags & BT_BOND_DB_SCHEDULES)) return 1;
+
+	keys = (const AES_EXPANDED_KEY *)((const unsigned char *)h + h->IrkKeyOffset);
+	for (i = 0; i < h->IrkCount; i++)
+	{
+		if (keys[i].Nr != 10) return 0;
+	}
+	keys = (const AES_EXPANDED_KEY *)((const unsigned char *)h + h->LtkKeyOffset);
+	for (i = 0; i < h->Count; i++)
+	{
+		if (keys[i].Nr != 10) return 0;
+	}
+	return 1;
+}
+
+int Bt_BondDbOpen(
+	BT_BOND_DB *pDb,
+	const char *pPath
+	)
+{
+	const BT_BOND_DB_HEADER *h;
+	const unsigned char *base;
+	int i;
+
+	memset(pDb, 0, sizeof(*pDb));
+	if (!Map(pDb, pPath) || !Validate((const BT_BOND_DB_HEADER *)pDb->Base, pDb->Size))
+	{
+		Unmap(pDb);
+		return 0;
+	}
+
+	base = (const unsigned char *)pDb->Base;
+	h = (const BT_BOND_DB_HEADER *)base;
+	pDb->Records = (const BT_BOND_RECORD *)(base + h->RecordOffset);
+	pDb->Count = h->Count;
+	pDb->IrkRecord = (const unsigned int *)(base + h->IrkMapOffset);
+
+	if (h->Flags & BT_BOND_DB_SCHEDULES)
+	{
+		// The resolver only reads Keys, so the mapping can back the table.
+		// BT_IRK_TABLE has no const variant: Irks is read only by contract.
+		pDb->Irks.Keys = (AES_EXPANDED_KEY *)(base + h->IrkKeyOffset);
+		pDb->Irks.Count = pDb->Irks.Capacity = h->IrkCount;
+		pDb->Irks.Generation = 1;
+		pDb->LtkKeys = (const AES_EXPANDED_KEY *)(base + h->LtkKeyOffset);
+		pDb->Mapped = 1;
+		return 1;
+	}
+
+	// Records only: expand the IRKs now, LTKs on use
+	if (!Bt_IrkTableInit(&pDb->Irks, h->IrkCount > 0 ? h->IrkCount : 1))
+	{
+		Unmap(pDb);
+		return 0;
+	}
+	for (i = 0; i < (int)h->IrkCount; i++)
+	{
+		Bt_IrkTableAdd(&pDb->Irks, (unsigned char *)pDb->Records[pDb->IrkRecord[i]].Irk);
+	}
+	return 1;
+}
+
+void Bt_BondDbClose(
+	BT_BOND_DB *pDb
+	)
+{
+	if (!pDb->Mapped) Bt_IrkTableFree(&pDb->Irks);
+	Unmap(pDb);
+	memset(pDb, 0, sizeof(*pDb));
+}
+
+int Bt_BondDbResolve(
+	const BT_BOND_DB *pDb,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *record
+	)
+{
+	int resolved, i;
+
+	resolved = Bt_RPA_Resolve(&pDb->Irks, addr, Count, record);
+	for (i = 0; i < Count; i++)
+	{
+		if (record[i] >= 0) record[i] = pDb->IrkRecord[record[i]];
+	}
+	return resolved;
+}
+
+int Bt_BondDbEncrypt(
+	const BT_BOND_DB *pDb,
+	int Record,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	unsigned char ltk[16];
+
+	// Without an LTK the record's schedule is all zero, not a key
+	if (Record < 0 || Record >= pDb->Count) return 0;
+	if (!(pDb->Records[Record].Keys & BT_BOND_LTK)) return 0;
+
+	if (pDb->LtkKeys)
+	{
+		Bt_SMP_e_Expanded(&pDb->LtkKeys[Record], pPlainTextData, pEncryptedData);
+		return 1;
+	}
+	memcpy(ltk, pDb->Records[Record].Ltk, 16);
+	Bt_SMP_e(ltk, pPlainTextData, pEncryptedData);
+	SecureWipe(ltk, 16);
+	return 1;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	1000 bonds from a fixed generator, every third one without an IRK; bond
+	777 holds the ah sample IRK. The file is written with and without
+	schedules and mapped back: 708194 0dfbaa resolves to record 777 both
+	ways, e() under an LTK from the file matches Bt_SMP_e on the record, e()
+	is refused for record 1000 and for record 2, which has no LTK, and a
+	file with a damaged header or an IRK schedule claiming Nr = 200 is
+	refused.
+*/
+void Bt_BondDb_Test()
+{
+	static BT_BOND_RECORD bonds[1000];
+	unsigned char sample[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
+	unsigned char addr[1][6] = { { 0x70, 0x81, 0x94, 0x0d, 0xfb, 0xaa } };
+	unsigned char block[16] = { 0 }, ref[16], out[16];
+	const char *path = "bond_db_test.bin";
+	unsigned int seed = 5;
+	BT_BOND_DB_HEADER h;
+	BT_BOND_DB db;
+	FILE *f;
+	int nr = 200;
+	int i, j, pass, record;
+
+	memset(bonds, 0, sizeof(bonds));
+	for (i = 0; i < 1000; i++)
+	{
+		unsigned char *p = (unsigned char *)&bonds[i];
+		for (j = 0; j < 6 + 48; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			p[j < 6 ? j : j + 2] = (unsigned char)(seed >> 16);
+		}
+		bonds[i].AddrType = 0x01;
+		bonds[i].Addr[0] |= 0xC0;
+		bonds[i].Keys = BT_BOND_LTK | BT_BOND_CSRK | (i % 3 == 1 ? 0 : BT_BOND_IRK);
+	}
+	bonds[2].Keys &= ~BT_BOND_LTK;
+	memcpy(bonds[777].Irk, sample, 16);
+	block[15] = 0x01;
+	memcpy(ref, bonds[500].Ltk, 16);
+	Bt_SMP_e(ref, block, ref);
+
+	printf("--------------------------------------------------\n");
+	for (pass = 1; pass >= 0; pass--)
+	{
+		Bt_BondDbWrite(path, bonds, 1000, pass);
+		if (!Bt_BondDbOpen(&db, path))
+		{
+			printf("Bt_BondDbOpen  failed\n");
+			continue;
+		}
+		Bt_BondDbResolve(&db, addr, 1, &record);
+		Bt_BondDbEncrypt(&db, 500, block, out);
+		printf("%s %u bytes, %d IRKs, %s\n", pass ? "Schedules     " : "Records only  ",
+			(unsigned int)db.Size, db.Irks.Count, db.Mapped ? "mapped" : "expanded");
+		printf("RPA            "); printBytes(addr[0], 6); printf(" -> record %d\n", record);
+		printf("e(LTK 500)     %s\n", memcmp(out, ref, 16) == 0 ? "match" : "MISMATCH");
+		printf("e() refused    record 1000 %s, record 2 (no LTK) %s\n",
+			Bt_BondDbEncrypt(&db, 1000, block, out) ? "no" : "yes",
+			Bt_BondDbEncrypt(&db, 2, block, out) ? "no" : "yes");
+		Bt_BondDbClose(&db);
+	}
+
+	// Corrupt the record size field
+	f = fopen(path, "r+b");
+	if (f != NULL)
+	{
+		fseek(f, 16, SEEK_SET);
+		fputc(0x7f, f);
+		fclose(f);
+	}
+	printf("Damaged header %s\n", Bt_BondDbOpen(&db, path) ? "accepted" : "refused");
+
+	// Corrupt the round count of the first IRK schedule
+	Bt_BondDbWrite(path, bonds, 1000, 1);
+	f = fopen(path, "r+b");
+	if (f != NULL)
+	{
+		if (fread(&h, sizeof(h), 1, f) == 1)
+		{
+			fseek(f, (long)(h.IrkKeyOffset + offsetof(AES_EXPANDED_KEY, Nr)), SEEK_SET);
+			fwrite(&nr, sizeof(nr), 1, f);
+		}
+		fclose(f);
+	}
+	printf("Schedule Nr    %s\n", Bt_BondDbOpen(&db, path) ? "accepted" : "refused");
+	remove(path);
+	printf("--------------------------------------------------\n");
+}
@@ -0,0 +1,115 @@
+#ifndef __BLE_BOND_DB_H
+#define __BLE_BOND_DB_H
+
+#include <stddef.h>
+#include "aes_encrypt.h"
+#include "ble_rpa.h"
+
+#define BT_BOND_DB_MAGIC		"BTBONDDB"
+#define BT_BOND_DB_VERSION		1
+
+// Header flag: the file carries expanded IRK and LTK schedules
+#define BT_BOND_DB_SCHEDULES	0x0001
+
+// Record key flags
+#define BT_BOND_IRK				0x01
+#define BT_BOND_LTK				0x02
+#define BT_BOND_CSRK			0x04
+
+// One bond, 128 bytes, so records never straddle a cache line pair
+typedef struct _BT_BOND_RECORD
+{
+	unsigned char Addr[6];			// identity address, MSB first
+	unsigned char AddrType;			// 0x00 public, 0x01 static random
+	unsigned char Keys;				// BT_BOND_IRK | BT_BOND_LTK | BT_BOND_CSRK
+	unsigned char Irk[16];
+	unsigned char Ltk[16];
+	unsigned char Csrk[16];
+	unsigned char Rand[8];			// legacy LTK Rand
+	unsigned short Ediv;			// legacy LTK EDIV
+	unsigned char Reserved[62];
+} BT_BOND_RECORD;
+
+/*
+* File layout, every section starting on a 4096 byte boundary:
+*
+*   header | records[Count] | IRK record map[IrkCount] |
+*   IRK schedules[IrkCount] | LTK schedules[Count]
+*
+* The schedule sections are present with BT_BOND_DB_SCHEDULES. Every
+* engine uses the same expanded key layout, so they are valid whichever
+* engine the reader selected. Offsets are from the start of the file.
+*/
+typedef struct _BT_BOND_DB_HEADER
+{
+	char Magic[8];					// BT_BOND_DB_MAGIC
+	unsigned int Version;
+	unsigned int Flags;
+	unsigned int RecordSize;		// sizeof(BT_BOND_RECORD)
+	unsigned int KeySize;			// sizeof(AES_EXPANDED_KEY)
+	unsigned int Count;				// records
+	unsigned int IrkCount;			// records with an IRK
+	unsigned int RecordOffset;
+	unsigned int IrkMapOffset;		// IRK handle -> record index
+	unsigned int IrkKeyOffset;
+	unsigned int LtkKeyOffset;
+	unsigned int FileSize;
+} BT_BOND_DB_HEADER;
+
+// An opened, read only bond database. With schedules in the file, Irks and
+// LtkKeys point straight into the mapping and nothing is expanded at open.
+// Irks is read only even though BT_IRK_TABLE is not const: its Keys may be
+// the read only mapping, so never pass it to Bt_IrkTableAdd or free it.
+typedef struct _BT_BOND_DB
+{
+	const BT_BOND_RECORD *Records;
+	int Count;
+	BT_IRK_TABLE Irks;				// read only; identity handle = IRK handle, see IrkRecord
+	const unsigned int *IrkRecord;	// IRK handle -> record index
+	const AES_EXPANDED_KEY *LtkKeys;// Count schedules, NULL without BT_BOND_DB_SCHEDULES
+	int Mapped;						// Irks.Keys lives in the mapping
+	void *Base;
+	size_t Size;
+	void *File;						// platform handles
+	void *Mapping;
+} BT_BOND_DB;
+
+// Write Count records to a new owner only file that replaces pPath once
+// complete; returns 0 on an I/O error and leaves any old database alone
+int Bt_BondDbWrite(
+	const char *pPath,
+	const BT_BOND_RECORD *pRecords,
+	int Count,
+	int WithSchedules
+	);
+
+// Map a database read only; returns 0 when it is missing or malformed
+int Bt_BondDbOpen(
+	BT_BOND_DB *pDb,
+	const char *pPath
+	);
+
+void Bt_BondDbClose(
+	BT_BOND_DB *pDb
+	);
+
+// Resolve RPAs against the bonded IRKs; record[i] is a record index or -1
+int Bt_BondDbResolve(
+	const BT_BOND_DB *pDb,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *record
+	);
+
+// Security function e under the LTK of a record. Returns 0, leaving
+// pEncryptedData alone, when Record is out of range or has no LTK.
+int Bt_BondDbEncrypt(
+	const BT_BOND_DB *pDb,
+	int Record,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+void Bt_BondDb_Test();
+
+#endif
@@ -0,0 +1,306 @@
+/****************************************************************/
+/* Bonded IRKs under read-copy-update                           */
+/* Readers publish the global epoch they entered in and load    */
+/* the current snapshot; both are sequentially consistent, so a */
+/* writer that swaps the snapshot and then advances the epoch   */
+/* either sees a reader's slot or that reader already sees the  */
+/* new snapshot. After the swap the writer waits until every    */
+/* slot is quiescent (0) or at the new epoch, then frees.       */
+/****************************************************************/
+#include "stdafx.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "ble_irk_set.h"
+#include "ble_rpa.h"
+#include "ble_smp_crypto.h"
+#include "crypto_helper.h"
+
+typedef struct _BT_IRK_READER
+{
+	std::atomic<unsigned int> Epoch;	// 0 while outside a read side section
+	std::atomic<bool> InUse;			// claimed by a registered thread
+	char Pad[64 - sizeof(std::atomic<unsigned int>) - sizeof(std::atomic<bool>)];
+} BT_IRK_READER;
+
+struct _BT_IRK_SET
+{
+	std::atomic<BT_IRK_SNAPSHOT *> Current;
+	std::atomic<unsigned int> Epoch;
+	std::mutex Writer;
+	BT_IRK_READER Slots[BT_IRK_SET_READERS];
+};
+
+static BT_IRK_SNAPSHOT *SnapshotAlloc(int Capacity)
+{
+	BT_IRK_SNAPSHOT *s = (BT_IRK_SNAPSHOT *)malloc(sizeof(BT_IRK_SNAPSHOT));
+
+	if (Capacity < 1) Capacity = 1;
+	if (s == NULL) return NULL;
+	s->Bonds = (int *)malloc(Capacity * sizeof(int));
+	if (s->Bonds == NULL || !Bt_IrkTableInit(&s->Table, Capacity))
+	{
+		free(s->Bonds);
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+static void SnapshotFree(BT_IRK_SNAPSHOT *s)
+{
+	Bt_IrkTableFree(&s->Table);
+	free(s->Bonds);
+	free(s);
+}
+
+// Copy of old without the IRK of Bond, with room for one more
+static BT_IRK_SNAPSHOT *SnapshotCopy(const BT_IRK_SNAPSHOT *old, int Bond)
+{
+	BT_IRK_SNAPSHOT *s = SnapshotAlloc(old->Table.Count + 1);
+	int i, n = 0;
+
+	if (s == NULL) return NULL;
+	for (i = 0; i < old->Table.Count; i++)
+	{
+		if (old->Bonds[i] == Bond) continue;
+		memcpy(&s->Table.Keys[n], &old->Table.Keys[i], sizeof(AES_EXPANDED_KEY));
+		s->Bonds[n++] = old->Bonds[i];
+	}
+	s->Table.Count = n;
+	s->Table.Generation = old->Table.Generation + 1;
+	return s;
+}
+
+// Swap in the new snapshot, wait out the readers of the old one, free it
+static void Publish(BT_IRK_SET *pSet, BT_IRK_SNAPSHOT *s)
+{
+	BT_IRK_SNAPSHOT *old = pSet->Current.exchange(s);
+	unsigned int epoch = pSet->Epoch.fetch_add(1) + 1;
+	unsigned int e;
+	int i;
+
+	for (i = 0; i < BT_IRK_SET_READERS; i++)
+	{
+		for (;;)
+		{
+			e = pSet->Slots[i].Epoch.load();
+			if (e == 0 || (int)(e - epoch) >= 0) break;
+			std::this_thread::yield();
+		}
+	}
+	SnapshotFree(old);
+}
+
+BT_IRK_SET *Bt_IrkSetCreate()
+{
+	BT_IRK_SET *pSet = new BT_IRK_SET;
+	BT_IRK_SNAPSHOT *s = SnapshotAlloc(1);
+	int i;
+
+	if (s == NULL)
+	{
+		delete pSet;
+		return NULL;
+	}
+	pSet->Current = s;
+	pSet->Epoch = 1;
+	for (i = 0; i < BT_IRK_SET_READERS; i++)
+	{
+		pSet->Slots[i].Epoch = 0;
+		pSet->Slots[i].InUse = false;
+	}
+	return pSet;
+}
+
+void Bt_IrkSetDestroy(
+	BT_IRK_SET *pSet
+	)
+{
+	SnapshotFree(pSet->Current.load());
+	delete pSet;
+}
+
+#define VALID_READER(Reader)	((Reader) >= 0 && (Reader) < BT_IRK_SET_READERS)
+
+int Bt_IrkSetRegister(
+	BT_IRK_SET *pSet
+	)
+{
+	bool unused;
+	int i;
+
+	for (i = 0; i < BT_IRK_SET_READERS; i++)
+	{
+		unused = false;
+		if (pSet->Slots[i].InUse.compare_exchange_strong(unused, true)) return i;
+	}
+	return -1;
+}
+
+void Bt_IrkSetUnregister(
+	BT_IRK_SET *pSet,
+	int Reader
+	)
+{
+	if (!VALID_READER(Reader)) return;
+	pSet->Slots[Reader].Epoch.store(0, std::memory_order_release);
+	pSet->Slots[Reader].InUse.store(false, std::memory_order_release);
+}
+
+const BT_IRK_SNAPSHOT *Bt_IrkSetEnter(
+	BT_IRK_SET *pSet,
+	int Reader
+	)
+{
+	if (!VALID_READER(Reader)) return NULL;
+	pSet->Slots[Reader].Epoch.store(pSet->Epoch.load());
+	return pSet->Current.load();
+}
+
+void Bt_IrkSetLeave(
+	BT_IRK_SET *pSet,
+	int Reader
+	)
+{
+	if (!VALID_READER(Reader)) return;
+	pSet->Slots[Reader].Epoch.store(0, std::memory_order_release);
+}
+
+int Bt_IrkSetAdd(
+	BT_IRK_SET *pSet,
+	int Bond,
+	unsigned char irk[16]
+	)
+{
+	std::lock_guard<std::mutex> lock(pSet->Writer);
+	BT_IRK_SNAPSHOT *s = SnapshotCopy(pSet->Current.load(), Bond);
+
+	if (s == NULL) return 0;
+	AES_128_ExpandKey(irk, &s->Table.Keys[s->Table.Count]);
+	s->Bonds[s->Table.Count++] = Bond;
+	Publish(pSet, s);
+	return 1;
+}
+
+int Bt_IrkSetRemove(
+	BT_IRK_SET *pSet,
+	int Bond
+	)
+{
+	std::lock_guard<std::mutex> lock(pSet->Writer);
+	const BT_IRK_SNAPSHOT *old = pSet->Current.load();
+	BT_IRK_SNAPSHOT *s;
+	int i;
+
+	for (i = 0; i < old->Table.Count; i++)
+	{
+		if (old->Bonds[i] == Bond) break;
+	}
+	if (i == old->Table.Count) return 0;
+
+	s = SnapshotCopy(old, Bond);
+	if (s == NULL) return 0;
+	Publish(pSet, s);
+	return 1;
+}
+
+int Bt_IrkSetResolve(
+	BT_IRK_SET *pSet,
+	int Reader,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *bond
+	)
+{
+	const BT_IRK_SNAPSHOT *s = Bt_IrkSetEnter(pSet, Reader);
+	int resolved, i;
+
+	if (s == NULL) return -1;
+	resolved = Bt_RPA_Resolve(&s->Table, addr, Count, bond);
+	for (i = 0; i < Count; i++)
+	{
+		if (bond[i] >= 0) bond[i] = s->Bonds[bond[i]];
+	}
+	Bt_IrkSetLeave(pSet, Reader);
+	return resolved;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	Bonds 10, 20 and 30, the ah sample IRK belonging to bond 20. The sample
+	address keeps resolving to bond 20 when bond 10 in front of it goes away.
+	Then a reader thread resolves the sample address in a loop while the main
+	thread adds and removes 500 other bonds; every answer must be bond 20.
+	Last, every reader slot is claimed, one more Register must fail, and a
+	slot given back must be handed out again.
+*/
+static void IrkSetReader(BT_IRK_SET *pSet, std::atomic<bool> *pStop, int *pWrong)
+{
+	unsigned char addr[1][6] = { { 0x70, 0x81, 0x94, 0x0d, 0xfb, 0xaa } };
+	int reader = Bt_IrkSetRegister(pSet);
+	int bond;
+
+	if (reader < 0)
+	{
+		(*pWrong)++;
+		return;
+	}
+	while (!pStop->load())
+	{
+		Bt_IrkSetResolve(pSet, reader, addr, 1, &bond);
+		if (bond != 20) (*pWrong)++;
+	}
+	Bt_IrkSetUnregister(pSet, reader);
+}
+
+void Bt_IrkSet_Test()
+{
+	unsigned char sample[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
+	unsigned char addr[1][6] = { { 0x70, 0x81, 0x94, 0x0d, 0xfb, 0xaa } };
+	unsigned char irk[16] = { 0 };
+	std::atomic<bool> stop(false);
+	BT_IRK_SET *set = Bt_IrkSetCreate();
+	int reader = Bt_IrkSetRegister(set);
+	int slots[BT_IRK_SET_READERS];
+	int bond, wrong = 0, i, extra, again;
+
+	irk[0] = 10; Bt_IrkSetAdd(set, 10, irk);
+	Bt_IrkSetAdd(set, 20, sample);
+	irk[0] = 30; Bt_IrkSetAdd(set, 30, irk);
+
+	printf("--------------------------------------------------\n");
+	Bt_IrkSetResolve(set, reader, addr, 1, &bond);
+	printf("Bonds 10 20 30 "); printBytes(addr[0], 6); printf(" -> %d\n", bond);
+	Bt_IrkSetRemove(set, 10);
+	Bt_IrkSetResolve(set, reader, addr, 1, &bond);
+	printf("Bond 10 gone   "); printBytes(addr[0], 6); printf(" -> %d\n", bond);
+
+	std::thread t(IrkSetReader, set, &stop, &wrong);
+	for (i = 0; i < 500; i++)
+	{
+		irk[0] = (unsigned char)i; irk[1] = 0x5a;
+		Bt_IrkSetAdd(set, 100 + i, irk);
+		if (i % 3 == 0) Bt_IrkSetRemove(set, 100 + i / 2);
+	}
+	stop = true;
+	t.join();
+	printf("Churn          %d IRKs, %d wrong\n", Bt_IrkSetEnter(set, reader)->Table.Count, wrong);
+	Bt_IrkSetLeave(set, reader);
+	Bt_IrkSetUnregister(set, reader);
+
+	for (i = 0; i < BT_IRK_SET_READERS; i++) slots[i] = Bt_IrkSetRegister(set);
+	extra = Bt_IrkSetRegister(set);
+	Bt_IrkSetUnregister(set, slots[5]);
+	again = Bt_IrkSetRegister(set);
+	printf("Reader slots   %d taken, one more %d, %d given back and reused %s\n",
+		slots[BT_IRK_SET_READERS - 1] + 1, extra, slots[5], again == slots[5] ? "ok" : "FAIL");
+	printf("Bad reader     resolve %d\n", Bt_IrkSetResolve(set, extra, addr, 1, &bond));
+	for (i = 0; i < BT_IRK_SET_READERS; i++) Bt_IrkSetUnregister(set, slots[i]);
+	printf("--------------------------------------------------\n");
+
+	Bt_IrkSetDestroy(set);
+}
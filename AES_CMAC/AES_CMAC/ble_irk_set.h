@@ -0,0 +1,86 @@
+#ifndef __BLE_IRK_SET_H
+#define __BLE_IRK_SET_H
+
+#include "ble_rpa.h"
+
+// Threads that may resolve against one IRK set at the same time
+#define BT_IRK_SET_READERS		16
+
+// One published, immutable version of the bonded IRKs. Table indexes move
+// when a bond is removed, so Bonds maps them back to the caller's bond ids.
+typedef struct _BT_IRK_SNAPSHOT
+{
+	BT_IRK_TABLE Table;				// pre-expanded schedules, never modified once published
+	int *Bonds;						// Table.Count bond ids
+} BT_IRK_SNAPSHOT;
+
+/*
+* Bonded IRKs under read-copy-update.
+*
+* Readers announce the epoch they start in, take the current snapshot and
+* resolve against it without any lock. A writer copies the snapshot (the
+* schedules are copied, only a new IRK is expanded), publishes the copy
+* with one pointer swap and then waits until no reader can still be inside
+* an older epoch before freeing the old copy. Writers are serialized among
+* themselves; they never block readers.
+*/
+typedef struct _BT_IRK_SET BT_IRK_SET;
+
+BT_IRK_SET *Bt_IrkSetCreate();
+
+void Bt_IrkSetDestroy(
+	BT_IRK_SET *pSet
+	);
+
+// Reserve a free reader slot for the calling thread; -1 when all are taken
+int Bt_IrkSetRegister(
+	BT_IRK_SET *pSet
+	);
+
+// Give the slot back once the thread is done with the set. The thread
+// must not be inside a read side section.
+void Bt_IrkSetUnregister(
+	BT_IRK_SET *pSet,
+	int Reader
+	);
+
+// Start a read side section. The snapshot stays valid until Bt_IrkSetLeave.
+// NULL when Reader is not a slot number.
+const BT_IRK_SNAPSHOT *Bt_IrkSetEnter(
+	BT_IRK_SET *pSet,
+	int Reader
+	);
+
+void Bt_IrkSetLeave(
+	BT_IRK_SET *pSet,
+	int Reader
+	);
+
+// Add an IRK for bond, or replace the one the bond already has.
+// Returns 0 when out of memory.
+int Bt_IrkSetAdd(
+	BT_IRK_SET *pSet,
+	int Bond,
+	unsigned char irk[16]
+	);
+
+// Returns 0 when the bond has no IRK in the set
+int Bt_IrkSetRemove(
+	BT_IRK_SET *pSet,
+	int Bond
+	);
+
+// Bt_RPA_Resolve inside one read side section; bond[i] is the bond id
+// of the matching IRK or -1. Returns the number of resolved addresses,
+// or -1 when Reader is not a slot number.
+int Bt_IrkSetResolve(
+	BT_IRK_SET *pSet,
+	int Reader,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *bond
+	);
+
+void Bt_IrkSet_Test();
+
+#endif
@@ -0,0 +1,717 @@
+/****************************************************************/
+/* P-256 ECDH for LE Secure Connections                         */
+/* Field elements are eight 32 bit limbs; products are 32 x 32 */
+/* -> 64 bit columns (same on Win32 and x64) reduced with the   */
+/* NIST fast reduction for p. Points are Jacobian, a = -3.      */
+/* Key generation walks a fixed base comb (8 teeth, 256 affine  */
+/* points built once at startup); the DHKey uses signed 5 bit   */
+/* windows over a per call table. Table lookups read every      */
+/* entry and keep the one wanted with masks.                    */
+/****************************************************************/
+#include "stdafx.h"
+#include "ble_p256.h"
+#include "crypto_helper.h"
+
+typedef unsigned int P256_FE[8];	// little endian limbs
+
+typedef struct _P256_JACOBIAN
+{
+	P256_FE X, Y, Z;				// Z == 0 is the point at infinity
+} P256_JACOBIAN;
+
+typedef struct _P256_AFFINE
+{
+	P256_FE x, y;
+} P256_AFFINE;
+
+// p = 2^256 - 2^224 + 2^192 + 2^96 - 1
+static const P256_FE P256_P = { 0xffffffff, 0xffffffff, 0xffffffff, 0x00000000, 0x00000000, 0x00000000, 0x00000001, 0xffffffff };
+// Group order n
+static const P256_FE P256_N = { 0xfc632551, 0xf3b9cac2, 0xa7179e84, 0xbce6faad, 0xffffffff, 0xffffffff, 0x00000000, 0xffffffff };
+static const P256_FE P256_B = { 0x27d2604b, 0x3bce3c3e, 0xcc53b0f6, 0x651d06b0, 0x769886bc, 0xb3ebbd55, 0xaa3a93e7, 0x5ac635d8 };
+static const P256_FE P256_GX = { 0xd898c296, 0xf4a13945, 0x2deb33a0, 0x77037d81, 0x63a440f2, 0xf8bce6e5, 0xe12c4247, 0x6b17d1f2 };
+static const P256_FE P256_GY = { 0x37bf51f5, 0xcbb64068, 0x6b315ece, 0x2bce3357, 0x7c0f9e16, 0x8ee7eb4a, 0xfe1a7f9b, 0x4fe342e2 };
+
+static const P256_FE P256_One = { 1 };
+// Filled in by P256Init
+static P256_AFFINE P256_Comb[256];	// entry i = sum of 2^(32 j) G over the bits j of i
+
+/* Field arithmetic mod p, inputs and outputs fully reduced */
+
+// r = t - p when t (with carry above it) is at least p, else t
+static void fe_reduce_once(P256_FE r, const unsigned int *t, unsigned int carry)
+{
+	P256_FE s;
+	unsigned long long d;
+	unsigned int borrow = 0, mask;
+	int j;
+
+	for (j = 0; j < 8; j++)
+	{
+		d = (unsigned long long)t[j] - P256_P[j] - borrow;
+		s[j] = (unsigned int)d;
+		borrow = (unsigned int)(d >> 32) & 1;
+	}
+	mask = 0u - (carry | (borrow ^ 1));
+	for (j = 0; j < 8; j++)
+	{
+		r[j] = (s[j] & mask) | (t[j] & ~mask);
+	}
+}
+
+static void fe_add(P256_FE r, const P256_FE a, const P256_FE b)
+{
+	unsigned int t[8];
+	unsigned long long c = 0;
+	int j;
+
+	for (j = 0; j < 8; j++)
+	{
+		c += (unsigned long long)a[j] + b[j];
+		t[j] = (unsigned int)c;
+		c >>= 32;
+	}
+	fe_reduce_once(r, t, (unsigned int)c);
+}
+
+static void fe_sub(P256_FE r, const P256_FE a, const P256_FE b)
+{
+	unsigned int t[8], mask;
+	unsigned long long d, c = 0;
+	unsigned int borrow = 0;
+	int j;
+
+	for (j = 0; j < 8; j++)
+	{
+		d = (unsigned long long)a[j] - b[j] - borrow;
+		t[j] = (unsigned int)d;
+		borrow = (unsigned int)(d >> 32) & 1;
+	}
+	// went below zero: add p back
+	mask = 0u - borrow;
+	for (j = 0; j < 8; j++)
+	{
+		c += (unsigned long long)t[j] + (P256_P[j] & mask);
+		r[j] = (unsigned int)c;
+		c >>= 32;
+	}
+}
+
+/*
+* NIST fast reduction (FIPS 186-4 D.2.3) of a 512 bit product c15..c0:
+* r = s1 + 2 s2 + 2 s3 + s4 + s5 - s6 - s7 - s8 - s9, collected per word.
+* What spills past 2^256 is folded back with 2^256 = 2^224 - 2^192 - 2^96 + 1
+* (mod p); two folds always suffice, then at most one p is subtracted.
+*/
+static void fe_reduce_wide(P256_FE r, const unsigned int *c)
+{
+	long long w[8], acc;
+	unsigned int out[8];
+	int j, fold;
+
+	w[0] = (long long)c[0] + c[8] + c[9] - c[11] - c[12] - c[13] - c[14];
+	w[1] = (long long)c[1] + c[9] + c[10] - c[12] - c[13] - c[14] - c[15];
+	w[2] = (long long)c[2] + c[10] + c[11] - c[13] - c[14] - c[15];
+	w[3] = (long long)c[3] + 2 * (long long)c[11] + 2 * (long long)c[12] + c[13] - c[15] - c[8] - c[9];
+	w[4] = (long long)c[4] + 2 * (long long)c[12] + 2 * (long long)c[13] + c[14] - c[9] - c[10];
+	w[5] = (long long)c[5] + 2 * (long long)c[13] + 2 * (long long)c[14] + c[15] - c[10] - c[11];
+	w[6] = (long long)c[6] + 3 * (long long)c[14] + 2 * (long long)c[15] + c[13] - c[8] - c[9];
+	w[7] = (long long)c[7] + 3 * (long long)c[15] + c[8] - c[10] - c[11] - c[12] - c[13];
+
+	for (fold = 0; fold < 3; fold++)
+	{
+		acc = 0;
+		for (j = 0; j < 8; j++)
+		{
+			acc += w[j];
+			out[j] = (unsigned int)acc;
+			acc >>= 32;					// arithmetic: negative words borrow
+		}
+		for (j = 0; j < 8; j++) w[j] = out[j];
+		w[0] += acc;
+		w[3] -= acc;
+		w[6] -= acc;
+		w[7] += acc;
+	}
+	fe_reduce_once(r, out, 0);
+}
+
+// r = a * b mod p, the product is built column by column (Comba)
+static void fe_mul(P256_FE r, const P256_FE a, const P256_FE b)
+{
+	unsigned int c[16];
+	unsigned long long lo = 0, p;
+	unsigned int hi = 0;
+	int i, k;
+
+	for (k = 0; k < 15; k++)
+	{
+		for (i = (k < 8 ? 0 : k - 7); i <= (k < 8 ? k : 7); i++)
+		{
+			p = (unsigned long long)a[i] * b[k - i];
+			lo += p;
+			hi += lo < p;
+		}
+		c[k] = (unsigned int)lo;
+		lo = (lo >> 32) | ((unsigned long long)hi << 32);
+		hi = 0;
+	}
+	c[15] = (unsigned int)lo;
+	fe_reduce_wide(r, c);
+}
+
+static void fe_sqr(P256_FE r, const P256_FE a)
+{
+	fe_mul(r, a, a);
+}
+
+static void fe_sqr_n(P256_FE r, const P256_FE a, int n)
+{
+	fe_sqr(r, a);
+	while (--n > 0) fe_sqr(r, r);
+}
+
+/*
+* r = a^(p-2) = 1 / a. Addition chain over the runs of ones in
+* p - 2 = ffffffff 00000001 00000000 00000000 00000000 ffffffff ffffffff fffffffd:
+* 255 squarings and 12 multiplications.
+*/
+static void fe_inv(P256_FE r, const P256_FE a)
+{
+	P256_FE x2, x3, x6, x12, x15, x30, x32, t;
+
+	fe_sqr(x2, a);          fe_mul(x2, x2, a);		// 2^2 - 1
+	fe_sqr(x3, x2);         fe_mul(x3, x3, a);		// 2^3 - 1
+	fe_sqr_n(x6, x3, 3);    fe_mul(x6, x6, x3);
+	fe_sqr_n(x12, x6, 6);   fe_mul(x12, x12, x6);
+	fe_sqr_n(x15, x12, 3);  fe_mul(x15, x15, x3);
+	fe_sqr_n(x30, x15, 15); fe_mul(x30, x30, x15);
+	fe_sqr_n(x32, x30, 2);  fe_mul(x32, x32, x2);	// 2^32 - 1
+
+	fe_sqr_n(t, x32, 32);   fe_mul(t, t, a);		// ffffffff 00000001
+	fe_sqr_n(t, t, 128);    fe_mul(t, t, x32);		// ... 00000000 x3 ffffffff
+	fe_sqr_n(t, t, 32);     fe_mul(t, t, x32);		// ... ffffffff
+	fe_sqr_n(t, t, 30);     fe_mul(t, t, x30);		// ... 3fffffff
+	fe_sqr_n(t, t, 2);      fe_mul(r, t, a);		// ... fffffffd
+}
+
+static int fe_is_zero(const P256_FE a)
+{
+	unsigned int x = 0;
+	int j;
+
+	for (j = 0; j < 8; j++) x |= a[j];
+	return x == 0;
+}
+
+// 0 when a < m, else 1
+static int fe_geq(const unsigned int *a, const unsigned int *m)
+{
+	int j;
+
+	for (j = 7; j >= 0; j--)
+	{
+		if (a[j] != m[j]) return a[j] > m[j];
+	}
+	return 1;
+}
+
+static void fe_from_bytes(P256_FE r, const unsigned char b[32])
+{
+	int j;
+
+	for (j = 0; j < 8; j++)
+	{
+		r[j] = ((unsigned int)b[31 - 4 * j - 3] << 24) | ((unsigned int)b[31 - 4 * j - 2] << 16) |
+			((unsigned int)b[31 - 4 * j - 1] << 8) | b[31 - 4 * j];
+	}
+}
+
+static void fe_to_bytes(unsigned char b[32], const P256_FE a)
+{
+	int j;
+
+	for (j = 0; j < 8; j++)
+	{
+		b[31 - 4 * j - 3] = (unsigned char)(a[j] >> 24);
+		b[31 - 4 * j - 2] = (unsigned char)(a[j] >> 16);
+		b[31 - 4 * j - 1] = (unsigned char)(a[j] >> 8);
+		b[31 - 4 * j] = (unsigned char)a[j];
+	}
+}
+
+// r = flag ? a : r, without a branch on flag
+static void fe_cmov(P256_FE r, const P256_FE a, unsigned int flag)
+{
+	unsigned int mask = 0u - flag;
+	int j;
+
+	for (j = 0; j < 8; j++) r[j] = (a[j] & mask) | (r[j] & ~mask);
+}
+
+/* Point arithmetic */
+
+static void p256_set_infinity(P256_JACOBIAN *r)
+{
+	memcpy(r->X, P256_One, sizeof(P256_FE));
+	memcpy(r->Y, P256_One, sizeof(P256_FE));
+	memset(r->Z, 0, sizeof(P256_FE));
+}
+
+// dbl-2001-b; r may be a
+static void p256_double(P256_JACOBIAN *r, const P256_JACOBIAN *a)
+{
+	P256_FE delta, gamma, beta, alpha, t1, t2;
+
+	fe_sqr(delta, a->Z);
+	fe_sqr(gamma, a->Y);
+	fe_mul(beta, a->X, gamma);
+	fe_sub(t1, a->X, delta);
+	fe_add(t2, a->X, delta);
+	fe_mul(alpha, t1, t2);
+	fe_add(t1, alpha, alpha);
+	fe_add(alpha, alpha, t1);				// 3 (X - delta)(X + delta)
+
+	fe_add(t1, a->Y, a->Z);
+	fe_sqr(t1, t1);
+	fe_sub(t1, t1, gamma);
+	fe_sub(r->Z, t1, delta);				// Z3 = (Y + Z)^2 - gamma - delta
+
+	fe_add(beta, beta, beta);
+	fe_add(beta, beta, beta);				// 4 beta
+	fe_sqr(t1, alpha);
+	fe_add(t2, beta, beta);
+	fe_sub(r->X, t1, t2);					// X3 = alpha^2 - 8 beta
+
+	fe_sub(t1, beta, r->X);
+	fe_mul(t1, alpha, t1);
+	fe_sqr(gamma, gamma);
+	fe_add(gamma, gamma, gamma);
+	fe_add(gamma, gamma, gamma);
+	fe_add(gamma, gamma, gamma);			// 8 gamma^2
+	fe_sub(r->Y, t1, gamma);				// Y3 = alpha (4 beta - X3) - 8 gamma^2
+}
+
+/*
+* r = a + b with b affine (madd-2007-bl); r may be a. a at infinity is
+* handled without a branch. a == b or a == -b only happen for specially
+* chosen inputs and take the slow branch below.
+*/
+static void p256_add_mixed(P256_JACOBIAN *r, const P256_JACOBIAN *a, const P256_AFFINE *b)
+{
+	P256_FE z1z1, u2, s2, h, hh, i, j, rr, v, t;
+	P256_JACOBIAN out;
+	unsigned int a_inf = fe_is_zero(a->Z);
+
+	fe_sqr(z1z1, a->Z);
+	fe_mul(u2, b->x, z1z1);
+	fe_mul(s2, b->y, a->Z);
+	fe_mul(s2, s2, z1z1);
+	fe_sub(h, u2, a->X);
+	fe_sub(rr, s2, a->Y);
+
+	if (!a_inf && fe_is_zero(h))
+	{
+		if (fe_is_zero(rr))
+		{
+			p256_double(r, a);
+		}
+		else
+		{
+			p256_set_infinity(r);
+		}
+		return;
+	}
+
+	fe_sqr(hh, h);
+	fe_add(i, hh, hh);
+	fe_add(i, i, i);						// I = 4 HH
+	fe_mul(j, h, i);
+	fe_add(rr, rr, rr);						// r = 2 (S2 - Y1)
+	fe_mul(v, a->X, i);
+
+	fe_sqr(out.X, rr);
+	fe_sub(out.X, out.X, j);
+	fe_sub(out.X, out.X, v);
+	fe_sub(out.X, out.X, v);				// X3 = r^2 - J - 2 V
+
+	fe_sub(t, v, out.X);
+	fe_mul(t, rr, t);
+	fe_mul(out.Y, a->Y, j);
+	fe_add(out.Y, out.Y, out.Y);
+	fe_sub(out.Y, t, out.Y);				// Y3 = r (V - X3) - 2 Y1 J
+
+	fe_add(t, a->Z, h);
+	fe_sqr(t, t);
+	fe_sub(t, t, z1z1);
+	fe_sub(out.Z, t, hh);					// Z3 = (Z1 + H)^2 - Z1Z1 - HH
+
+	// a at infinity: the sum is b
+	fe_cmov(out.X, b->x, a_inf);
+	fe_cmov(out.Y, b->y, a_inf);
+	fe_cmov(out.Z, P256_One, a_inf);
+	*r = out;
+}
+
+// Most points p256_normalize takes at once (the p256_mul_var table)
+#define P256_NORMALIZE_MAX	16
+
+// Jacobian to affine for n <= P256_NORMALIZE_MAX points none of which is
+// at infinity, one inversion. Runs per operation, so no heap.
+static void p256_normalize(P256_AFFINE *r, const P256_JACOBIAN *a, int n)
+{
+	P256_FE prefix[P256_NORMALIZE_MAX];
+	P256_FE inv, zinv, zinv2;
+	int k;
+
+	memcpy(prefix[0], a[0].Z, sizeof(P256_FE));
+	for (k = 1; k < n; k++) fe_mul(prefix[k], prefix[k - 1], a[k].Z);
+	fe_inv(inv, prefix[n - 1]);
+	for (k = n - 1; k >= 0; k--)
+	{
+		if (k > 0)
+		{
+			fe_mul(zinv, inv, prefix[k - 1]);
+			fe_mul(inv, inv, a[k].Z);
+		}
+		else
+		{
+			memcpy(zinv, inv, sizeof(P256_FE));
+		}
+		fe_sqr(zinv2, zinv);
+		fe_mul(r[k].x, a[k].X, zinv2);
+		fe_mul(zinv2, zinv2, zinv);
+		fe_mul(r[k].y, a[k].Y, zinv2);
+	}
+}
+
+// r = table[index], reading every entry; all zero when index >= n
+static void p256_lookup(P256_AFFINE *r, const P256_AFFINE *table, int n, unsigned int index)
+{
+	unsigned int d, mask;
+	int k, j;
+
+	memset(r, 0, sizeof(*r));
+	for (k = 0; k < n; k++)
+	{
+		d = (unsigned int)k ^ index;
+		mask = ((d | (0u - d)) >> 31) - 1;		// all ones iff d == 0, for any d
+		for (j = 0; j < 8; j++)
+		{
+			r->x[j] |= table[k].x[j] & mask;
+			r->y[j] |= table[k].y[j] & mask;
+		}
+	}
+}
+
+static void p256_cmov(P256_JACOBIAN *r, const P256_JACOBIAN *a, unsigned int flag)
+{
+	fe_cmov(r->X, a->X, flag);
+	fe_cmov(r->Y, a->Y, flag);
+	fe_cmov(r->Z, a->Z, flag);
+}
+
+// k G: bit 32 j + i of k is bit i of limb j, so one comb column is one bit
+// of every limb. 31 doublings and 32 mixed additions.
+static void p256_mul_base(P256_JACOBIAN *r, const P256_FE k)
+{
+	P256_JACOBIAN sum;
+	P256_AFFINE t;
+	unsigned int index;
+	int i, j;
+
+	p256_set_infinity(r);
+	for (i = 31; i >= 0; i--)
+	{
+		if (i != 31) p256_double(r, r);
+		index = 0;
+		for (j = 0; j < 8; j++) index |= ((k[j] >> i) & 1) << j;
+		p256_lookup(&t, P256_Comb, 256, index);
+		p256_add_mixed(&sum, r, &t);
+		p256_cmov(r, &sum, index != 0);
+	}
+	SecureWipe(&sum, sizeof(sum));
+	SecureWipe(&t, sizeof(t));
+	SecureWipe(&index, sizeof(index));
+}
+
+// Bits [pos, pos + 6) of k, bits outside 0..255 read as zero
+static unsigned int scalar_window(const P256_FE k, int pos)
+{
+	unsigned int w = 0;
+	int b;
+
+	for (b = 0; b < 6; b++)
+	{
+		if (pos + b >= 0 && pos + b < 256) w |= ((k[(pos + b) >> 5] >> ((pos + b) & 31)) & 1) << b;
+	}
+	return w;
+}
+
+// Signed digit in -16..16 from a 6 bit window (Booth recoding)
+static unsigned int booth_recode(unsigned int in, unsigned int *sign)
+{
+	unsigned int s = ~((in >> 5) - 1);
+	unsigned int d = (1u << 6) - in - 1;
+
+	d = (d & s) | (in & ~s);
+	d = (d >> 1) + (d & 1);
+	*sign = s & 1;
+	return d;
+}
+
+// k P with signed 5 bit windows: 255 doublings and 52 mixed additions
+static void p256_mul_var(P256_JACOBIAN *r, const P256_FE k, const P256_AFFINE *p)
+{
+	static const P256_FE zero = { 0 };
+	P256_JACOBIAN jt[16], sum;
+	P256_AFFINE table[16], t;
+	P256_FE neg;
+	unsigned int digit, sign;
+	int w, i;
+
+	// table[i] = (i + 1) P
+	memcpy(jt[0].X, p->x, sizeof(P256_FE));
+	memcpy(jt[0].Y, p->y, sizeof(P256_FE));
+	memcpy(jt[0].Z, P256_One, sizeof(P256_FE));
+	p256_double(&jt[1], &jt[0]);
+	for (i = 2; i < 16; i++) p256_add_mixed(&jt[i], &jt[i - 1], p);
+	p256_normalize(table, jt, 16);
+
+	p256_set_infinity(r);
+	for (w = 51; w >= 0; w--)
+	{
+		if (w != 51)
+		{
+			for (i = 0; i < 5; i++) p256_double(r, r);
+		}
+		digit = booth_recode(scalar_window(k, 5 * w - 1), &sign);
+		// digit 0 reads 16 P (index 15): a real point for the addition,
+		// whose result the cmov below then drops
+		p256_lookup(&t, table, 16, (digit - 1) & 15);
+		fe_sub(neg, zero, t.y);
+		fe_cmov(t.y, neg, sign);
+		p256_add_mixed(&sum, r, &t);
+		p256_cmov(r, &sum, digit != 0);
+	}
+	SecureWipe(jt, sizeof(jt));
+	SecureWipe(table, sizeof(table));
+	SecureWipe(&sum, sizeof(sum));
+	SecureWipe(&t, sizeof(t));
+	SecureWipe(neg, sizeof(neg));
+	SecureWipe(&digit, sizeof(digit));
+	SecureWipe(&sign, sizeof(sign));
+}
+
+// Affine x of a point; 0 at infinity
+static int p256_affine_x(P256_FE x, const P256_JACOBIAN *a)
+{
+	P256_FE zinv;
+
+	if (fe_is_zero(a->Z)) return 0;
+	fe_inv(zinv, a->Z);
+	fe_sqr(zinv, zinv);
+	fe_mul(x, a->X, zinv);
+	return 1;
+}
+
+// The comb table for G. 0 when out of memory, and Bt_P256_PublicKey then
+// refuses to run rather than read an empty table.
+static int P256Init()
+{
+	P256_JACOBIAN *jt = (P256_JACOBIAN *)malloc(256 * sizeof(P256_JACOBIAN));
+	P256_AFFINE basis[8];
+	P256_JACOBIAN b[8];
+	int i, j, low;
+
+	if (jt == NULL) return 0;
+	// basis points 2^(32 j) G
+	memcpy(b[0].X, P256_GX, sizeof(P256_FE));
+	memcpy(b[0].Y, P256_GY, sizeof(P256_FE));
+	memcpy(b[0].Z, P256_One, sizeof(P256_FE));
+	for (j = 1; j < 8; j++)
+	{
+		b[j] = b[j - 1];
+		for (i = 0; i < 32; i++) p256_double(&b[j], &b[j]);
+	}
+	p256_normalize(basis, b, 8);
+
+	jt[0] = b[0];								// never selected, keeps normalize simple
+	for (i = 1; i < 256; i++)
+	{
+		for (low = 0; !((i >> low) & 1); low++);
+		if (i == (1 << low))
+		{
+			jt[i] = b[low];
+		}
+		else
+		{
+			p256_add_mixed(&jt[i], &jt[i & (i - 1)], &basis[low]);
+		}
+	}
+	for (i = 0; i < 256; i += P256_NORMALIZE_MAX)
+	{
+		p256_normalize(P256_Comb + i, jt + i, P256_NORMALIZE_MAX);
+	}
+	free(jt);
+	return 1;
+}
+
+// Built before main, like the AES engine selection; read only afterwards
+static int P256Ready = P256Init();
+
+// 0 < k < n
+static int scalar_valid(const P256_FE k)
+{
+	return !fe_is_zero(k) && !fe_geq(k, P256_N);
+}
+
+int Bt_P256_PublicKey(
+	const unsigned char priv[32],
+	unsigned char x[32],
+	unsigned char y[32]
+	)
+{
+	P256_JACOBIAN q;
+	P256_AFFINE a;
+	P256_FE k;
+
+	if (!P256Ready) return 0;
+	fe_from_bytes(k, priv);
+	if (!scalar_valid(k))
+	{
+		SecureWipe(k, sizeof(k));
+		return 0;
+	}
+	p256_mul_base(&q, k);
+	p256_normalize(&a, &q, 1);
+	fe_to_bytes(x, a.x);
+	fe_to_bytes(y, a.y);
+	SecureWipe(k, sizeof(k));
+	SecureWipe(&q, sizeof(q));
+	return 1;
+}
+
+int Bt_P256_GenerateKeyPair(
+	unsigned char priv[32],
+	unsigned char x[32],
+	unsigned char y[32]
+	)
+{
+	do
+	{
+		if (!OsRandomBytes(priv, 32)) return 0;
+	} while (!Bt_P256_PublicKey(priv, x, y));		// out of range: about 2^-32
+	return 1;
+}
+
+// Coordinates below p and y^2 = x^3 - 3 x + b
+static int p256_load_public(P256_AFFINE *a, const unsigned char x[32], const unsigned char y[32])
+{
+	P256_FE lhs, rhs, t;
+
+	fe_from_bytes(a->x, x);
+	fe_from_bytes(a->y, y);
+	if (fe_geq(a->x, P256_P) || fe_geq(a->y, P256_P)) return 0;
+
+	fe_sqr(lhs, a->y);
+	fe_sqr(rhs, a->x);
+	fe_mul(rhs, rhs, a->x);
+	fe_add(t, a->x, a->x);
+	fe_add(t, t, a->x);
+	fe_sub(rhs, rhs, t);
+	fe_add(rhs, rhs, P256_B);
+	fe_sub(t, lhs, rhs);
+	return fe_is_zero(t);
+}
+
+int Bt_P256_ValidatePublicKey(
+	const unsigned char x[32],
+	const unsigned char y[32]
+	)
+{
+	P256_AFFINE a;
+
+	return p256_load_public(&a, x, y);
+}
+
+int Bt_P256_DHKey(
+	const unsigned char priv[32],
+	const unsigned char x[32],
+	const unsigned char y[32],
+	unsigned char dhkey[32]
+	)
+{
+	P256_JACOBIAN q;
+	P256_AFFINE peer;
+	P256_FE k, w;
+	int ok;
+
+	// An off curve key would let the peer pick a weak curve (invalid curve attack)
+	if (!p256_load_public(&peer, x, y)) return 0;
+	fe_from_bytes(k, priv);
+	if (!scalar_valid(k))
+	{
+		SecureWipe(k, sizeof(k));
+		return 0;
+	}
+
+	p256_mul_var(&q, k, &peer);
+	ok = p256_affine_x(w, &q);
+	if (ok) fe_to_bytes(dhkey, w);
+	SecureWipe(k, sizeof(k));
+	SecureWipe(&q, sizeof(q));
+	SecureWipe(w, sizeof(w));
+	return ok;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	Core spec Vol 3 Part H 2.3.5.6.1 debug key and the P-256 sample data:
+	Private A      3f49f6d4 a3c55f38 74c9b3e3 d2103f50 4aff607b eb40b799 5899b8a6 cd3c1abd
+	Public A(x)    20b003d2 f297be2c 5e2c83a7 e9f9a5b9 eff49111 acf4fddb cc030148 0e359de6
+	Public A(y)    dc809c49 652aeb6d 63329abf 5a52155c 766345c2 8fed3024 741c8ed0 1589d28b
+	Private B      55188b3d 32f6bb9a 900afcfb eed4e72a 59cb9ac2 f19d7cfb 6b4fdd49 f47fc5fd
+	Public B(x)    1ea1f0f0 1faf1d96 09592284 f19e4c00 47b58afd 8615a69f 559077b2 2faaa190
+	Public B(y)    4c55f33e 429dad37 7356703a 9ab85160 472d1130 e28e3676 5f89aff9 15b1214a
+	DHKey          ec0234a3 57c8ad05 341010a6 0a397d9b 99796b13 b4f866f1 868d34f3 73bfa698
+*/
+void Bt_P256_Test()
+{
+	unsigned char priv_a[32] = { 0x3f, 0x49, 0xf6, 0xd4, 0xa3, 0xc5, 0x5f, 0x38, 0x74, 0xc9, 0xb3, 0xe3, 0xd2, 0x10, 0x3f, 0x50,
+								 0x4a, 0xff, 0x60, 0x7b, 0xeb, 0x40, 0xb7, 0x99, 0x58, 0x99, 0xb8, 0xa6, 0xcd, 0x3c, 0x1a, 0xbd };
+	unsigned char priv_b[32] = { 0x55, 0x18, 0x8b, 0x3d, 0x32, 0xf6, 0xbb, 0x9a, 0x90, 0x0a, 0xfc, 0xfb, 0xee, 0xd4, 0xe7, 0x2a,
+								 0x59, 0xcb, 0x9a, 0xc2, 0xf1, 0x9d, 0x7c, 0xfb, 0x6b, 0x4f, 0xdd, 0x49, 0xf4, 0x7f, 0xc5, 0xfd };
+	unsigned char ax[32], ay[32], bx[32], by[32];
+	unsigned char dh_a[32], dh_b[32];
+	unsigned char priv_c[32], cx[32], cy[32], dh_c[32], dh_d[32];
+	int ok_a, ok_b;
+
+	printf("--------------------------------------------------\n");
+	Bt_P256_PublicKey(priv_a, ax, ay);
+	Bt_P256_PublicKey(priv_b, bx, by);
+	printf("Public A(x)    "); printBytes(ax, 32); printf("\n");
+	printf("Public A(y)    "); printBytes(ay, 32); printf("\n");
+	printf("Public B(x)    "); printBytes(bx, 32); printf("\n");
+	printf("Public B(y)    "); printBytes(by, 32); printf("\n");
+
+	ok_a = Bt_P256_DHKey(priv_a, bx, by, dh_a);
+	ok_b = Bt_P256_DHKey(priv_b, ax, ay, dh_b);
+	printf("DHKey          "); printBytes(dh_a, 32); printf("\n");
+	printf("  from B side  %s\n", ok_a && ok_b && memcmp(dh_a, dh_b, 32) == 0 ? "match" : "MISMATCH");
+
+	ay[31] ^= 0x01;
+	printf("Off curve key  %s\n", Bt_P256_DHKey(priv_b, ax, ay, dh_b) ? "accepted" : "refused");
+	ay[31] ^= 0x01;
+	memset(ax, 0xff, 32);
+	printf("x >= p         %s\n", Bt_P256_ValidatePublicKey(ax, ay) ? "accepted" : "refused");
+
+	Bt_P256_GenerateKeyPair(priv_c, cx, cy);
+	Bt_P256_DHKey(priv_c, bx, by, dh_c);
+	Bt_P256_DHKey(priv_b, cx, cy, dh_d);
+	printf("Random pair    %s\n", memcmp(dh_c, dh_d, 32) == 0 ? "agree" : "DISAGREE");
+	printf("--------------------------------------------------\n");
+}
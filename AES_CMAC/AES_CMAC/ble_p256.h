@@ -0,0 +1,42 @@
+#ifndef __BLE_P256_H
+#define __BLE_P256_H
+
+/*
+* P-256 (secp256r1) for LE Secure Connections. Private keys, public key
+* coordinates and the DHKey are 32 bytes, most significant byte first,
+* the order in which f4, f5 and g2 take U, V and W.
+*/
+
+// Public key of a private key; returns 0 unless 0 < priv < n
+int Bt_P256_PublicKey(
+	const unsigned char priv[32],
+	unsigned char x[32],
+	unsigned char y[32]
+	);
+
+// Fresh key pair from the OS generator; returns 0 when it is unavailable
+int Bt_P256_GenerateKeyPair(
+	unsigned char priv[32],
+	unsigned char x[32],
+	unsigned char y[32]
+	);
+
+// Nonzero when (x, y) is a point on the curve. A peer key that is not must
+// be refused before it is used, see Bt_P256_DHKey.
+int Bt_P256_ValidatePublicKey(
+	const unsigned char x[32],
+	const unsigned char y[32]
+	);
+
+// DHKey = x coordinate of priv * (x, y). Returns 0 when the peer key fails
+// validation or priv is out of range.
+int Bt_P256_DHKey(
+	const unsigned char priv[32],
+	const unsigned char x[32],
+	const unsigned char y[32],
+	unsigned char dhkey[32]
+	);
+
+void Bt_P256_Test();
+
+#endif
@@ -0,0 +1,202 @@
+/****************************************************************/
+/* P-256 key pair pool                                          */
+/* Slots hold the pairs; two index rings say which slots are    */
+/* free and which are ready. The refill thread moves free ->    */
+/* ready, Take moves ready -> free after copying the pair out   */
+/* and wiping the slot, so a private key is never handed out    */
+/* twice and does not stay in the pool once taken.              */
+/****************************************************************/
+#include "stdafx.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "ble_p256.h"
+#include "ble_p256_pool.h"
+#include "ble_ring.h"
+#include "crypto_helper.h"
+#if defined(_MSC_VER)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Longest the refill thread sleeps on a full pool without being woken
+#define BT_P256_POOL_IDLE_MS	100
+
+struct _BT_P256_POOL
+{
+	BtMpmcRing<int, BT_P256_POOL_MAX> Free;
+	BtMpmcRing<int, BT_P256_POOL_MAX> Ready;
+	BT_P256_KEYPAIR Slots[BT_P256_POOL_MAX];
+
+	std::atomic<int> ReadyCount;
+	std::atomic<bool> Stop;
+	std::atomic<unsigned int> Generated;
+	std::atomic<unsigned int> Taken;
+	std::atomic<unsigned int> Inline;
+
+	std::mutex Lock;				// only for sleeping on Wake
+	std::condition_variable Wake;
+	std::thread Refill;
+};
+
+// Key generation should only use otherwise idle CPU time
+static void LowerPriority(std::thread &t)
+{
+#if defined(_MSC_VER)
+	SetThreadPriority(t.native_handle(), THREAD_PRIORITY_LOWEST);
+#elif defined(SCHED_IDLE)
+	struct sched_param sp;
+
+	memset(&sp, 0, sizeof(sp));
+	pthread_setschedparam(t.native_handle(), SCHED_IDLE, &sp);
+#endif
+}
+
+static void RefillMain(BT_P256_POOL *p)
+{
+	BT_P256_KEYPAIR *pair;
+	int slot;
+
+	while (!p->Stop.load(std::memory_order_relaxed))
+	{
+		if (!p->Free.Pop(slot))
+		{
+			// Full. Take wakes us without holding the lock, so a wakeup can
+			// be missed; the timeout bounds how long that delays a refill.
+			std::unique_lock<std::mutex> lock(p->Lock);
+			p->Wake.wait_for(lock, std::chrono::milliseconds(BT_P256_POOL_IDLE_MS));
+			continue;
+		}
+		pair = &p->Slots[slot];
+		if (!Bt_P256_GenerateKeyPair(pair->Priv, pair->X, pair->Y))
+		{
+			p->Free.Push(slot);
+			std::this_thread::sleep_for(std::chrono::milliseconds(BT_P256_POOL_IDLE_MS));
+			continue;
+		}
+		p->Generated.fetch_add(1, std::memory_order_relaxed);
+		p->Ready.Push(slot);
+		p->ReadyCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+BT_P256_POOL *Bt_P256PoolCreate(
+	int Capacity
+	)
+{
+	BT_P256_POOL *p = new BT_P256_POOL;
+	int i;
+
+	if (Capacity < 1) Capacity = 1;
+	if (Capacity > BT_P256_POOL_MAX) Capacity = BT_P256_POOL_MAX;
+
+	memset(p->Slots, 0, sizeof(p->Slots));
+	for (i = 0; i < Capacity; i++) p->Free.Push(i);
+	p->ReadyCount = 0;
+	p->Stop = false;
+	p->Generated = p->Taken = p->Inline = 0;
+
+	p->Refill = std::thread(RefillMain, p);
+	LowerPriority(p->Refill);
+	return p;
+}
+
+int Bt_P256PoolTake(
+	BT_P256_POOL *pPool,
+	BT_P256_KEYPAIR *pPair
+	)
+{
+	int slot;
+
+	if (!pPool->Ready.Pop(slot))
+	{
+		pPool->Inline.fetch_add(1, std::memory_order_relaxed);
+		pPool->Wake.notify_one();
+		return Bt_P256_GenerateKeyPair(pPair->Priv, pPair->X, pPair->Y);
+	}
+	pPool->ReadyCount.fetch_sub(1, std::memory_order_relaxed);
+	memcpy(pPair, &pPool->Slots[slot], sizeof(BT_P256_KEYPAIR));
+	SecureWipe(&pPool->Slots[slot], sizeof(BT_P256_KEYPAIR));
+	pPool->Free.Push(slot);
+	pPool->Taken.fetch_add(1, std::memory_order_relaxed);
+	pPool->Wake.notify_one();
+	return 1;
+}
+
+int Bt_P256PoolReady(
+	BT_P256_POOL *pPool
+	)
+{
+	return pPool->ReadyCount.load(std::memory_order_relaxed);
+}
+
+void Bt_P256PoolStats(
+	BT_P256_POOL *pPool,
+	BT_P256_POOL_STATS *pStats
+	)
+{
+	pStats->Generated = pPool->Generated.load();
+	pStats->Taken = pPool->Taken.load();
+	pStats->Inline = pPool->Inline.load();
+}
+
+void Bt_P256PoolDestroy(
+	BT_P256_POOL *pPool
+	)
+{
+	pPool->Stop = true;
+	pPool->Wake.notify_one();
+	pPool->Refill.join();
+	SecureWipe(pPool->Slots, sizeof(pPool->Slots));
+	delete pPool;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	A pool of 16 fills up in the background. All 16 pairs are then taken
+	from it: each must be on the curve and different from the others, and
+	two of them must agree on a DHKey, as two devices pairing would.
+*/
+void Bt_P256_Pool_Test()
+{
+	BT_P256_POOL *pool = Bt_P256PoolCreate(16);
+	BT_P256_POOL_STATS stats;
+	BT_P256_KEYPAIR pairs[16];
+	unsigned char dh_a[32], dh_b[32];
+	int valid = 0, distinct = 1, wait, i, j;
+
+	for (wait = 0; wait < 500 && Bt_P256PoolReady(pool) < 16; wait++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	printf("--------------------------------------------------\n");
+	printf("Ready          %d\n", Bt_P256PoolReady(pool));
+	for (i = 0; i < 16; i++)
+	{
+		Bt_P256PoolTake(pool, &pairs[i]);
+		valid += Bt_P256_ValidatePublicKey(pairs[i].X, pairs[i].Y);
+		for (j = 0; j < i; j++)
+		{
+			if (memcmp(pairs[i].Priv, pairs[j].Priv, 32) == 0) distinct = 0;
+		}
+	}
+	Bt_P256PoolStats(pool, &stats);
+	printf("Taken          %u from the pool, %u inline\n", stats.Taken, stats.Inline);
+	printf("On curve       %d, %s\n", valid, distinct ? "all distinct" : "REPEATED");
+
+	Bt_P256_DHKey(pairs[0].Priv, pairs[1].X, pairs[1].Y, dh_a);
+	Bt_P256_DHKey(pairs[1].Priv, pairs[0].X, pairs[0].Y, dh_b);
+	printf("DHKey          %s\n", memcmp(dh_a, dh_b, 32) == 0 ? "agree" : "MISMATCH");
+	printf("--------------------------------------------------\n");
+
+	Bt_P256PoolDestroy(pool);
+	SecureWipe(pairs, sizeof(pairs));
+}
@@ -0,0 +1,56 @@
+#ifndef __BLE_P256_POOL_H
+#define __BLE_P256_POOL_H
+
+// Most key pairs a pool holds
+#define BT_P256_POOL_MAX		256
+
+typedef struct _BT_P256_KEYPAIR
+{
+	unsigned char Priv[32];			// MSB first, as Bt_P256_DHKey takes it
+	unsigned char X[32];
+	unsigned char Y[32];
+} BT_P256_KEYPAIR;
+
+typedef struct _BT_P256_POOL_STATS
+{
+	unsigned int Generated;			// pairs made by the refill thread
+	unsigned int Taken;				// pairs handed out from the pool
+	unsigned int Inline;			// pairs made by Take because the pool was empty
+} BT_P256_POOL_STATS;
+
+/*
+* Precomputed LE Secure Connections key pairs. A refill thread running at
+* the lowest priority keeps the pool full; Bt_P256PoolTake hands a pair out
+* with two ring operations, so a pairing only waits for its DHKey. Every
+* pair is given out once and its slot is wiped when it is taken.
+*/
+typedef struct _BT_P256_POOL BT_P256_POOL;
+
+BT_P256_POOL *Bt_P256PoolCreate(
+	int Capacity					// 1 .. BT_P256_POOL_MAX
+	);
+
+// A fresh key pair; generated on the spot when the pool is empty. Returns
+// 0 only when the OS generator is unavailable.
+int Bt_P256PoolTake(
+	BT_P256_POOL *pPool,
+	BT_P256_KEYPAIR *pPair
+	);
+
+// Pairs ready to be taken
+int Bt_P256PoolReady(
+	BT_P256_POOL *pPool
+	);
+
+void Bt_P256PoolStats(
+	BT_P256_POOL *pPool,
+	BT_P256_POOL_STATS *pStats
+	);
+
+void Bt_P256PoolDestroy(
+	BT_P256_POOL *pPool
+	);
+
+void Bt_P256_Pool_Test();
+
+#endif
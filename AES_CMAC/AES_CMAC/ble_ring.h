@@ -0,0 +1,133 @@
+#ifndef __BLE_RING_H
+#define __BLE_RING_H
+
+#include <atomic>
+#include <stddef.h>
+
+// Keeps producer and consumer indices on separate cache lines
+#define BT_RING_PAD(name)	char name[64]
+
+/*
+* Bounded single producer / single consumer ring. Size must be a power
+* of two. Push and Pop never block; they fail when the ring is full or
+* empty and the caller decides whether to spin, yield or drop.
+*/
+template <typename T, unsigned int Size>
+class BtSpscRing
+{
+public:
+	BtSpscRing() : m_Head(0), m_Tail(0) {}
+
+	bool Push(const T &Item)
+	{
+		unsigned int tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) == Size) return false;
+		m_Items[tail & (Size - 1)] = Item;
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T &Item)
+	{
+		unsigned int head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire)) return false;
+		Item = m_Items[head & (Size - 1)];
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	BT_RING_PAD(m_Pad0);
+	std::atomic<unsigned int> m_Head;	// written by the consumer
+	BT_RING_PAD(m_Pad1);
+	std::atomic<unsigned int> m_Tail;	// written by the producer
+	BT_RING_PAD(m_Pad2);
+	T m_Items[Size];
+};
+
+/*
+* Bounded multi producer / multi consumer ring (D. Vyukov). Every cell
+* carries a sequence number telling whether it is ready to be written
+* (seq == pos) or read (seq == pos + 1), so producers and consumers only
+* contend on their own position counter with a compare-exchange.
+*/
+template <typename T, unsigned int Size>
+class BtMpmcRing
+{
+public:
+	BtMpmcRing() : m_EnqueuePos(0), m_DequeuePos(0)
+	{
+		for (unsigned int i = 0; i < Size; i++)
+		{
+			m_Cells[i].Seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool Push(const T &Item)
+	{
+		Cell *cell;
+		unsigned int pos = m_EnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_Cells[pos & (Size - 1)];
+			int dif = (int)(cell->Seq.load(std::memory_order_acquire) - pos);
+			if (dif == 0)
+			{
+				if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			}
+			else if (dif < 0)
+			{
+				return false;		// full
+			}
+			else
+			{
+				pos = m_EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		cell->Item = Item;
+		cell->Seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T &Item)
+	{
+		Cell *cell;
+		unsigned int pos = m_DequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_Cells[pos & (Size - 1)];
+			int dif = (int)(cell->Seq.load(std::memory_order_acquire) - (pos + 1));
+			if (dif == 0)
+			{
+				if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			}
+			else if (dif < 0)
+			{
+				return false;		// empty
+			}
+			else
+			{
+				pos = m_DequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+		Item = cell->Item;
+		cell->Seq.store(pos + Size, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<unsigned int> Seq;
+		T Item;
+	};
+
+	BT_RING_PAD(m_Pad0);
+	std::atomic<unsigned int> m_EnqueuePos;
+	BT_RING_PAD(m_Pad1);
+	std::atomic<unsigned int> m_DequeuePos;
+	BT_RING_PAD(m_Pad2);
+	Cell m_Cells[Size];
+};
+
+#endif
@@ -0,0 +1,434 @@
+/****************************************************************/
+/* Batch resolution of resolvable private addresses (RPA)      */
+/* Every bonded IRK is expanded once into a cache line aligned */
+/* table. A batch of addresses is then checked tile by tile:   */
+/* BT_RPA_TILE_IRKS schedules are swept against all pending    */
+/* addresses, BT_RPA_LANES addresses per AesEncryptBlocks call,*/
+/* before moving on to the next tile.                          */
+/****************************************************************/
+#include "stdafx.h"
+#include "aes_encrypt.h"
+#include "ble_smp_crypto.h"
+#include "ble_rpa.h"
+#include "crypto_helper.h"
+
+// Addresses examined per pass; bounds the pending list kept on the stack
+#define BT_RPA_BATCH		256
+
+int Bt_IrkTableInit(
+	BT_IRK_TABLE *pTable,
+	int Capacity
+	)
+{
+	pTable->Keys = (AES_EXPANDED_KEY *)AlignedAlloc(Capacity * sizeof(AES_EXPANDED_KEY), 64);
+	pTable->Count = 0;
+	pTable->Capacity = pTable->Keys ? Capacity : 0;
+	pTable->Generation = 0;
+	return pTable->Keys != NULL;
+}
+
+// Returns the identity handle of the new IRK, or -1 when the table is full
+int Bt_IrkTableAdd(
+	BT_IRK_TABLE *pTable,
+	unsigned char irk[16]
+	)
+{
+	if (pTable->Count == pTable->Capacity) return -1;
+	AES_128_ExpandKey(irk, &pTable->Keys[pTable->Count]);
+	pTable->Generation++;
+	return pTable->Count++;
+}
+
+void Bt_IrkTableFree(
+	BT_IRK_TABLE *pTable
+	)
+{
+	if (pTable->Keys)
+	{
+		SecureWipe(pTable->Keys, pTable->Capacity * sizeof(AES_EXPANDED_KEY));
+		AlignedFree(pTable->Keys);
+	}
+	pTable->Keys = NULL;
+	pTable->Count = pTable->Capacity = 0;
+}
+
+int Bt_RPA_IsResolvable(
+	const unsigned char addr[6]
+	)
+{
+	return (addr[0] & 0xC0) == 0x40;
+}
+
+int Bt_RPA_Resolve(
+	const BT_IRK_TABLE *pTable,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *identity
+	)
+{
+	const AES_EXPANDED_KEY *keys[BT_RPA_LANES];
+	unsigned char in[16 * BT_RPA_LANES], out[16 * BT_RPA_LANES];
+	int pending[BT_RPA_BATCH];
+	int base, n, np, i, j, k, l, lanes, tile, tile_end, kept;
+	int resolved = 0;
+
+	// r' = padding || prand, only the last three bytes change per lane
+	memset(in, 0, sizeof(in));
+
+	for (base = 0; base < Count; base += BT_RPA_BATCH)
+	{
+		n = Count - base;
+		if (n > BT_RPA_BATCH) n = BT_RPA_BATCH;
+
+		np = 0;
+		for (i = base; i < base + n; i++)
+		{
+			identity[i] = -1;
+			if (Bt_RPA_IsResolvable(addr[i])) pending[np++] = i;
+		}
+
+		for (tile = 0; tile < pTable->Count && np > 0; tile += BT_RPA_TILE_IRKS)
+		{
+			tile_end = tile + BT_RPA_TILE_IRKS;
+			if (tile_end > pTable->Count) tile_end = pTable->Count;
+
+			for (j = 0; j < np; j += BT_RPA_LANES)
+			{
+				lanes = np - j;
+				if (lanes > BT_RPA_LANES) lanes = BT_RPA_LANES;
+				for (l = 0; l < lanes; l++)
+				{
+					memcpy(in + 16 * l + 13, addr[pending[j + l]], 3);
+				}
+
+				for (k = tile; k < tile_end; k++)
+				{
+					// ah(IRK, prand) for every lane under IRK k
+					for (l = 0; l < lanes; l++) keys[l] = &pTable->Keys[k];
+					AesEncryptBlocks(keys, in, out, lanes);
+					for (l = 0; l < lanes; l++)
+					{
+						i = pending[j + l];
+						if (identity[i] < 0 && memcmp(out + 16 * l + 13, addr[i] + 3, 3) == 0)
+						{
+							identity[i] = k;	// lowest matching index wins
+						}
+					}
+				}
+			}
+
+			// drop the addresses this tile resolved
+			kept = 0;
+			for (j = 0; j < np; j++)
+			{
+				if (identity[pending[j]] < 0) pending[kept++] = pending[j];
+				else resolved++;
+			}
+			np = kept;
+		}
+	}
+	return resolved;
+}
+
+int Bt_RPA_ResolveKeyTable(
+	const AES_KEY_TABLE *pKeys,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *identity
+	)
+{
+	unsigned char in[16 * BT_RPA_TILE_IRKS], out[16 * BT_RPA_TILE_IRKS];
+	int index[BT_RPA_TILE_IRKS];
+	int pending[BT_RPA_BATCH];
+	int base, n, np, i, j, k, l, tile, tile_end, kept;
+	int resolved = 0;
+
+	memset(in, 0, sizeof(in));
+
+	for (base = 0; base < Count; base += BT_RPA_BATCH)
+	{
+		n = Count - base;
+		if (n > BT_RPA_BATCH) n = BT_RPA_BATCH;
+
+		np = 0;
+		for (i = base; i < base + n; i++)
+		{
+			identity[i] = -1;
+			if (Bt_RPA_IsResolvable(addr[i])) pending[np++] = i;
+		}
+
+		// Same tiling as Bt_RPA_Resolve, lanes across IRKs instead of addresses
+		for (tile = 0; tile < pKeys->Count && np > 0; tile += BT_RPA_TILE_IRKS)
+		{
+			tile_end = tile + BT_RPA_TILE_IRKS;
+			if (tile_end > pKeys->Count) tile_end = pKeys->Count;
+			for (k = tile; k < tile_end; k++) index[k - tile] = k;
+
+			for (j = 0; j < np; j++)
+			{
+				i = pending[j];
+				for (l = 0; l < tile_end - tile; l++)
+				{
+					memcpy(in + 16 * l + 13, addr[i], 3);
+				}
+				AesEncryptBlocksTable(pKeys, index, in, out, tile_end - tile);
+				for (l = 0; l < tile_end - tile; l++)
+				{
+					if (memcmp(out + 16 * l + 13, addr[i] + 3, 3) == 0)
+					{
+						identity[i] = tile + l;		// lowest matching index wins
+						break;
+					}
+				}
+			}
+
+			kept = 0;
+			for (j = 0; j < np; j++)
+			{
+				if (identity[pending[j]] < 0) pending[kept++] = pending[j];
+				else resolved++;
+			}
+			np = kept;
+		}
+	}
+	return resolved;
+}
+
+int Bt_RpaRngSeed(
+	BT_RPA_RNG *pRng
+	)
+{
+	unsigned char seed[32];
+
+	if (!OsRandomBytes(seed, sizeof(seed))) return 0;
+	AES_128_ExpandKey(seed, &pRng->Key);
+	memcpy(pRng->Counter, seed + 16, 16);
+	memset(pRng->Stream, 0, sizeof(pRng->Stream));
+	pRng->Used = sizeof(pRng->Stream);				// refill on first use
+	SecureWipe(seed, sizeof(seed));
+	return 1;
+}
+
+// Encrypt the next BT_RPA_RNG_BLOCKS + 2 counter values side by side; the
+// first two blocks replace key and counter, the rest is the new key stream
+static void RngRefill(BT_RPA_RNG *pRng)
+{
+	const AES_EXPANDED_KEY *keys[BT_RPA_RNG_BLOCKS + 2];
+	unsigned char block[16 * (BT_RPA_RNG_BLOCKS + 2)];
+	int i, j;
+
+	for (i = 0; i < BT_RPA_RNG_BLOCKS + 2; i++)
+	{
+		for (j = 15; j >= 0 && ++pRng->Counter[j] == 0; j--);	// big endian increment
+		memcpy(block + 16 * i, pRng->Counter, 16);
+		keys[i] = &pRng->Key;
+	}
+	AesEncryptBlocks(keys, block, block, BT_RPA_RNG_BLOCKS + 2);
+
+	AES_128_ExpandKey(block, &pRng->Key);
+	memcpy(pRng->Counter, block + 16, 16);
+	memcpy(pRng->Stream, block + 32, sizeof(pRng->Stream));
+	pRng->Used = 0;
+	SecureWipe(block, sizeof(block));
+}
+
+// 22 random bits, neither all zero nor all one, under the 01 marker
+static unsigned int RandomPrand(BT_RPA_RNG *pRng)
+{
+	unsigned char *p;
+	unsigned int r;
+
+	do
+	{
+		if (pRng->Used + 3 > (int)sizeof(pRng->Stream)) RngRefill(pRng);
+		p = pRng->Stream + pRng->Used;
+		pRng->Used += 3;
+		r = (((unsigned int)p[0] << 16) | ((unsigned int)p[1] << 8) | p[2]) & 0x3FFFFF;
+		memset(p, 0, 3);
+	} while (r == 0 || r == 0x3FFFFF);
+	return 0x400000 | r;
+}
+
+int Bt_RPA_Generate(
+	const BT_IRK_TABLE *pTable,
+	const int *handles,
+	int Count,
+	BT_RPA_RNG *pRng,
+	unsigned char (*addr)[6]
+	)
+{
+	const AES_EXPANDED_KEY *keys[BT_RPA_BATCH];
+	unsigned char block[16 * BT_RPA_BATCH];
+	int index[BT_RPA_BATCH];
+	int base, n, nk, i, generated = 0;
+	unsigned int prand;
+
+	// r' = padding || prand
+	memset(block, 0, sizeof(block));
+
+	for (base = 0; base < Count; base += BT_RPA_BATCH)
+	{
+		n = Count - base;
+		if (n > BT_RPA_BATCH) n = BT_RPA_BATCH;
+
+		nk = 0;
+		for (i = base; i < base + n; i++)
+		{
+			if (handles[i] < 0 || handles[i] >= pTable->Count)
+			{
+				memset(addr[i], 0, 6);
+				continue;
+			}
+			prand = RandomPrand(pRng);
+			addr[i][0] = (unsigned char)(prand >> 16);
+			addr[i][1] = (unsigned char)(prand >> 8);
+			addr[i][2] = (unsigned char)prand;
+			memset(block + 16 * nk, 0, 13);
+			memcpy(block + 16 * nk + 13, addr[i], 3);
+			keys[nk] = &pTable->Keys[handles[i]];
+			index[nk++] = i;
+		}
+
+		// one multi-key call: the lanes run BT_RPA_LANES IRKs side by side
+		AesEncryptBlocks(keys, block, block, nk);
+		for (i = 0; i < nk; i++)
+		{
+			memcpy(addr[index[i]] + 3, block + 16 * i + 13, 3);
+		}
+		generated += nk;
+	}
+	return generated;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	1000 IRKs from a fixed generator; IRK 777 is the ah sample key
+	ec0234a3 57c8ad05 341010a6 0a397d9b, so 708194 0dfbaa resolves to 777.
+	Addresses hashed with IRKs 0, 63, 64 and 999 (tile edges) resolve to
+	those handles, a random RPA and a static address resolve to -1.
+*/
+void Bt_RPA_Test()
+{
+	unsigned char sample[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
+	unsigned char irks[1000][16];
+	unsigned char addr[7][6] = {
+		{ 0x70, 0x81, 0x94, 0x0d, 0xfb, 0xaa },		// ah sample
+		{ 0x40, 0x00, 0x01 }, { 0x55, 0x12, 0x34 }, { 0x6a, 0xbc, 0xde }, { 0x7f, 0xff, 0xff },
+		{ 0x4c, 0x0f, 0xfe, 0x12, 0x34, 0x56 },		// random hash
+		{ 0xc1, 0x22, 0x33, 0x44, 0x55, 0x66 }		// static random address
+	};
+	int owners[4] = { 0, 63, 64, 999 };
+	int identity[7], identity2[7];
+	unsigned int seed = 1;
+	BT_IRK_TABLE table;
+	AES_KEY_TABLE keys;
+	int i, j, resolved, resolved2, same = 1;
+
+	for (i = 0; i < 1000; i++)
+	{
+		for (j = 0; j < 16; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			irks[i][j] = (unsigned char)(seed >> 16);
+		}
+	}
+	memcpy(irks[777], sample, 16);
+
+	Bt_IrkTableInit(&table, 1000);
+	for (i = 0; i < 1000; i++) Bt_IrkTableAdd(&table, irks[i]);
+
+	for (i = 0; i < 4; i++)
+	{
+		Bt_SMP_ah(irks[owners[i]], addr[1 + i], addr[1 + i] + 3);
+	}
+
+	resolved = Bt_RPA_Resolve(&table, addr, 7, identity);
+
+	AesKeyTableInit(&keys, 1000);
+	AesKeyTableAdd(&keys, irks, 1000);
+	resolved2 = Bt_RPA_ResolveKeyTable(&keys, addr, 7, identity2);
+	for (i = 0; i < 7; i++) same &= identity[i] == identity2[i];
+	AesKeyTableFree(&keys);
+
+	printf("--------------------------------------------------\n");
+	printf("IRKs           %d\n", table.Count);
+	for (i = 0; i < 7; i++)
+	{
+		printf("RPA            "); printBytes(addr[i], 6); printf(" -> %d\n", identity[i]);
+	}
+	printf("Resolved       %d\n", resolved);
+	printf("Key table      %d, %s\n", resolved2, same ? "same identities" : "MISMATCH");
+	printf("--------------------------------------------------\n");
+
+	Bt_IrkTableFree(&table);
+}
+
+/**
+	4096 RPAs for handles 0..999 of the resolver test table (IRK 777 is the ah
+	sample key). Every address has to carry the 01 marker, a valid prand and
+	hash correctly under the IRK of its handle (checked one block at a time,
+	and with Bt_SMP_ah for IRK 777); handle 1000 yields a zero address.
+*/
+void Bt_RPA_Generate_Test()
+{
+	static unsigned char addr[4097][6];
+	static int handles[4097];
+	unsigned char sample[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
+	unsigned char irk[16], hash[3], block[16];
+	unsigned int seed = 1, prand;
+	BT_IRK_TABLE table;
+	BT_RPA_RNG rng;
+	int i, j, generated, marker = 0, own = 0, n777 = 0, ah_ok = 0;
+
+	Bt_IrkTableInit(&table, 1000);
+	for (i = 0; i < 1000; i++)
+	{
+		for (j = 0; j < 16; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			irk[j] = (unsigned char)(seed >> 16);
+		}
+		Bt_IrkTableAdd(&table, i == 777 ? sample : irk);
+	}
+
+	for (i = 0; i < 4096; i++) handles[i] = (i * 7) % 1000;
+	handles[4096] = 1000;
+
+	// never generate from an unseeded stream: the addresses would be predictable
+	if (!Bt_RpaRngSeed(&rng))
+	{
+		printf("Bt_RpaRngSeed  failed\n");
+		Bt_IrkTableFree(&table);
+		return;
+	}
+	generated = Bt_RPA_Generate(&table, handles, 4097, &rng, addr);
+	for (i = 0; i < 4096; i++)
+	{
+		prand = ((unsigned int)(addr[i][0] & 0x3F) << 16) | (addr[i][1] << 8) | addr[i][2];
+		if ((addr[i][0] & 0xC0) == 0x40 && prand != 0 && prand != 0x3FFFFF) marker++;
+		memset(block, 0, 13);
+		memcpy(block + 13, addr[i], 3);
+		AesEncryptBlock(&table.Keys[handles[i]], block, block);
+		if (memcmp(block + 13, addr[i] + 3, 3) == 0) own++;
+		if (handles[i] == 777)
+		{
+			n777++;
+			Bt_SMP_ah(sample, addr[i], hash);
+			if (memcmp(hash, addr[i] + 3, 3) == 0) ah_ok++;
+		}
+	}
+
+	printf("--------------------------------------------------\n");
+	printf("Generated      %d\n", generated);
+	printf("01 marker      %d\n", marker);
+	printf("Own IRK        %d\n", own);
+	printf("Bt_SMP_ah      %d of %d for IRK 777\n", ah_ok, n777);
+	printf("Bad handle     "); printBytes(addr[4096], 6); printf("\n");
+	printf("--------------------------------------------------\n");
+
+	SecureWipe(&rng, sizeof(rng));
+	Bt_IrkTableFree(&table);
+}
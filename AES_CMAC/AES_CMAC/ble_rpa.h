@@ -0,0 +1,99 @@
+#ifndef __BLE_RPA_H
+#define __BLE_RPA_H
+
+#include "aes_encrypt.h"
+
+// IRKs per tile: their schedules (64 x 256 bytes) stay in L1/L2 while a
+// batch of addresses is checked against them
+#define BT_RPA_TILE_IRKS	64
+
+// Addresses encrypted side by side under one IRK
+#define BT_RPA_LANES		8
+
+// Table of bonded IRKs, expanded once when added. The schedules are
+// cache line aligned; the index of an IRK is its identity handle.
+typedef struct _BT_IRK_TABLE
+{
+	AES_EXPANDED_KEY *Keys;			// Capacity schedules, 64 byte aligned
+	int Count;						// IRKs in use
+	int Capacity;					// IRKs allocated
+	unsigned int Generation;		// bumped whenever the set of IRKs changes
+} BT_IRK_TABLE;
+
+int Bt_IrkTableInit(
+	BT_IRK_TABLE *pTable,
+	int Capacity
+	);
+
+int Bt_IrkTableAdd(
+	BT_IRK_TABLE *pTable,
+	unsigned char irk[16]
+	);
+
+void Bt_IrkTableFree(
+	BT_IRK_TABLE *pTable
+	);
+
+// An address is resolvable private when its two most significant bits are 01
+int Bt_RPA_IsResolvable(
+	const unsigned char addr[6]
+	);
+
+// Resolve Count addresses (MSB first: prand = addr[0..2], hash = addr[3..5]).
+// identity[i] receives the table index of the first matching IRK, or -1.
+// Returns the number of resolved addresses.
+int Bt_RPA_Resolve(
+	const BT_IRK_TABLE *pTable,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *identity
+	);
+
+// Bt_RPA_Resolve over a bulk expanded key table (AesKeyTableAdd): each lane
+// takes its own IRK, so one address is checked against BT_RPA_LANES
+// neighbouring IRKs per call, reading their round keys contiguously.
+// identity[i] receives the table index of the first matching IRK, or -1.
+int Bt_RPA_ResolveKeyTable(
+	const AES_KEY_TABLE *pKeys,
+	const unsigned char (*addr)[6],
+	int Count,
+	int *identity
+	);
+
+// Counter blocks encrypted per refill of the prand generator
+#define BT_RPA_RNG_BLOCKS	64
+
+// prand generator: AES-128 in counter mode, seeded from the OS. Every
+// refill encrypts BT_RPA_RNG_BLOCKS + 2 counter blocks in one multi-key
+// call; the first two become the next key and counter, so neither past
+// nor future prands follow from the addresses on the air or, for past
+// ones, from the state. Wipe the state when done with it.
+typedef struct _BT_RPA_RNG
+{
+	AES_EXPANDED_KEY Key;
+	unsigned char Counter[16];
+	unsigned char Stream[16 * BT_RPA_RNG_BLOCKS];	// key stream, consumed bytes zeroed
+	int Used;										// bytes of Stream consumed
+} BT_RPA_RNG;
+
+// Seed from the OS generator (BCryptGenRandom, /dev/urandom); 0 on failure
+int Bt_RpaRngSeed(
+	BT_RPA_RNG *pRng
+	);
+
+// Fresh RPAs (MSB first): random prand with top bits 01, not all zero or all
+// one in its 22 random bits, and hash = ah(IRK, prand) for the IRK at
+// handles[i]. Returns the number generated; an address for a handle outside
+// the table is zeroed.
+int Bt_RPA_Generate(
+	const BT_IRK_TABLE *pTable,
+	const int *handles,
+	int Count,
+	BT_RPA_RNG *pRng,
+	unsigned char (*addr)[6]
+	);
+
+void Bt_RPA_Test();
+void Bt_RPA_Generate_Test();
+
+#endif
@@ -0,0 +1,242 @@
+/****************************************************************/
+/* RPA -> identity cache                                        */
+/* An advertiser repeats the same RPA many times per second     */
+/* until it rotates, so a resolution (or the fact that no IRK   */
+/* matches) is kept in an open addressing table for Ttl time    */
+/* units. Linear probing is bounded to BT_RPA_CACHE_PROBES      */
+/* slots; when all of them are live the entry closest to expiry */
+/* is replaced. Any change of the IRK set drops every entry.    */
+/****************************************************************/
+#include "stdafx.h"
+#include "ble_rpa.h"
+#include "ble_rpa_cache.h"
+#include "crypto_helper.h"
+
+// Addresses looked up per pass; bounds the miss list kept on the stack
+#define BT_RPA_CACHE_BATCH		256
+
+static unsigned long long AddrKey(const unsigned char addr[6])
+{
+	return ((unsigned long long)addr[0] << 40) | ((unsigned long long)addr[1] << 32) |
+		((unsigned long long)addr[2] << 24) | ((unsigned long long)addr[3] << 16) |
+		((unsigned long long)addr[4] << 8) | (unsigned long long)addr[5];
+}
+
+static unsigned int AddrHash(const BT_RPA_CACHE *pCache, unsigned long long key)
+{
+	return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & pCache->Mask;
+}
+
+// Wrap safe "Expires is later than Now"
+static int IsLive(const BT_RPA_CACHE_ENTRY *e, unsigned int Now)
+{
+	return (int)(e->Expires - Now) > 0;
+}
+
+int Bt_RpaCacheInit(
+	BT_RPA_CACHE *pCache,
+	int Bits,						// 1 << Bits slots
+	unsigned int Ttl
+	)
+{
+	unsigned int slots;
+
+	// Every field is set even on failure: a cache without Entries is "no cache"
+	pCache->Entries = NULL;
+	pCache->Mask = 0;
+	pCache->Ttl = Ttl;
+	pCache->Generation = 0;
+	pCache->Hits = pCache->Misses = 0;
+	if (Bits < 1 || Bits > BT_RPA_CACHE_MAX_BITS) return 0;
+	slots = 1u << Bits;
+	pCache->Entries = (BT_RPA_CACHE_ENTRY *)AlignedAlloc(slots * sizeof(BT_RPA_CACHE_ENTRY), 64);
+	if (pCache->Entries == NULL) return 0;
+	pCache->Mask = slots - 1;
+	Bt_RpaCacheFlush(pCache);
+	return 1;
+}
+
+void Bt_RpaCacheFree(
+	BT_RPA_CACHE *pCache
+	)
+{
+	if (pCache->Entries) AlignedFree(pCache->Entries);
+	pCache->Entries = NULL;
+	pCache->Mask = 0;
+}
+
+void Bt_RpaCacheFlush(
+	BT_RPA_CACHE *pCache
+	)
+{
+	if (pCache->Entries == NULL) return;
+	memset(pCache->Entries, 0, (pCache->Mask + 1) * sizeof(BT_RPA_CACHE_ENTRY));
+}
+
+// Returns 1 and the cached identity (-1 = known unresolvable) on a hit
+int Bt_RpaCacheLookup(
+	BT_RPA_CACHE *pCache,
+	const unsigned char addr[6],
+	unsigned int Now,
+	int *identity
+	)
+{
+	unsigned long long key = AddrKey(addr);
+	unsigned int h = AddrHash(pCache, key);
+	int p;
+
+	if (pCache->Entries == NULL) return 0;
+	for (p = 0; p < BT_RPA_CACHE_PROBES; p++)
+	{
+		BT_RPA_CACHE_ENTRY *e = &pCache->Entries[(h + p) & pCache->Mask];
+		if (e->Key == 0) break;		// never used: the address is not further on
+		if (e->Key == key && IsLive(e, Now))
+		{
+			*identity = e->Identity;
+			pCache->Hits++;
+			return 1;
+		}
+	}
+	pCache->Misses++;
+	return 0;
+}
+
+void Bt_RpaCacheInsert(
+	BT_RPA_CACHE *pCache,
+	const unsigned char addr[6],
+	int identity,
+	unsigned int Now
+	)
+{
+	unsigned long long key = AddrKey(addr);
+	unsigned int h = AddrHash(pCache, key);
+	BT_RPA_CACHE_ENTRY *slot = NULL, *victim = NULL;
+	int p;
+
+	if (pCache->Entries == NULL) return;
+	for (p = 0; p < BT_RPA_CACHE_PROBES; p++)
+	{
+		BT_RPA_CACHE_ENTRY *e = &pCache->Entries[(h + p) & pCache->Mask];
+		if (e->Key == key)
+		{
+			slot = e;				// refresh the entry in place
+			break;
+		}
+		if (slot == NULL && (e->Key == 0 || !IsLive(e, Now)))
+		{
+			slot = e;				// first free or stale slot, keep looking for the key
+		}
+		if (victim == NULL || (int)(e->Expires - victim->Expires) < 0)
+		{
+			victim = e;
+		}
+		if (e->Key == 0) break;
+	}
+	if (slot == NULL) slot = victim;	// all live: evict the one closest to expiry
+
+	slot->Key = key;
+	slot->Identity = identity;
+	slot->Expires = Now + pCache->Ttl;
+}
+
+int Bt_RPA_ResolveCached(
+	BT_RPA_CACHE *pCache,
+	const BT_IRK_TABLE *pTable,
+	const unsigned char (*addr)[6],
+	int Count,
+	unsigned int Now,
+	int *identity
+	)
+{
+	unsigned char miss_addr[BT_RPA_CACHE_BATCH][6];
+	int miss_index[BT_RPA_CACHE_BATCH], miss_identity[BT_RPA_CACHE_BATCH];
+	int base, n, nm, i, resolved = 0;
+
+	if (pCache->Entries == NULL) return Bt_RPA_Resolve(pTable, addr, Count, identity);
+
+	// Handles may have moved and "unresolvable" may no longer hold
+	if (pCache->Generation != pTable->Generation)
+	{
+		Bt_RpaCacheFlush(pCache);
+		pCache->Generation = pTable->Generation;
+	}
+
+	for (base = 0; base < Count; base += BT_RPA_CACHE_BATCH)
+	{
+		n = Count - base;
+		if (n > BT_RPA_CACHE_BATCH) n = BT_RPA_CACHE_BATCH;
+
+		nm = 0;
+		for (i = base; i < base + n; i++)
+		{
+			if (!Bt_RPA_IsResolvable(addr[i]))
+			{
+				identity[i] = -1;
+			}
+			else if (!Bt_RpaCacheLookup(pCache, addr[i], Now, &identity[i]))
+			{
+				memcpy(miss_addr[nm], addr[i], 6);
+				miss_index[nm++] = i;
+			}
+			else if (identity[i] >= 0)
+			{
+				resolved++;
+			}
+		}
+
+		if (nm == 0) continue;
+		resolved += Bt_RPA_Resolve(pTable, miss_addr, nm, miss_identity);
+		for (i = 0; i < nm; i++)
+		{
+			identity[miss_index[i]] = miss_identity[i];
+			Bt_RpaCacheInsert(pCache, miss_addr[i], miss_identity[i], Now);
+		}
+	}
+	return resolved;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	Table with the ah sample IRK at handle 2. The sample address 708194 0dfbaa
+	misses once and then hits; an unresolvable RPA is cached as -1. Adding an
+	IRK changes the generation and flushes the cache, and an entry older than
+	the TTL (900) misses again.
+*/
+void Bt_RPA_Cache_Test()
+{
+	unsigned char irk[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
+	unsigned char other[16] = { 0 };
+	unsigned char addr[2][6] = {
+		{ 0x70, 0x81, 0x94, 0x0d, 0xfb, 0xaa },		// ah sample, IRK handle 2
+		{ 0x4c, 0x0f, 0xfe, 0x12, 0x34, 0x56 }		// no IRK matches
+	};
+	int identity[2];
+	BT_IRK_TABLE table;
+	BT_RPA_CACHE cache;
+
+	Bt_IrkTableInit(&table, 8);
+	other[0] = 1; Bt_IrkTableAdd(&table, other);
+	other[0] = 2; Bt_IrkTableAdd(&table, other);
+	Bt_IrkTableAdd(&table, irk);
+	Bt_RpaCacheInit(&cache, 10, 900);
+
+	printf("--------------------------------------------------\n");
+	Bt_RPA_ResolveCached(&cache, &table, addr, 2, 0, identity);
+	printf("t=0            %d %d  hits %u misses %u\n", identity[0], identity[1], cache.Hits, cache.Misses);
+	Bt_RPA_ResolveCached(&cache, &table, addr, 2, 10, identity);
+	printf("t=10           %d %d  hits %u misses %u\n", identity[0], identity[1], cache.Hits, cache.Misses);
+
+	other[0] = 3; Bt_IrkTableAdd(&table, other);
+	Bt_RPA_ResolveCached(&cache, &table, addr, 2, 20, identity);
+	printf("IRK added      %d %d  hits %u misses %u\n", identity[0], identity[1], cache.Hits, cache.Misses);
+
+	Bt_RPA_ResolveCached(&cache, &table, addr, 2, 20 + 900, identity);
+	printf("t=920 (TTL)    %d %d  hits %u misses %u\n", identity[0], identity[1], cache.Hits, cache.Misses);
+	printf("--------------------------------------------------\n");
+
+	Bt_RpaCacheFree(&cache);
+	Bt_IrkTableFree(&table);
+}
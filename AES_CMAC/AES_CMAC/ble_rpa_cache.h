@@ -0,0 +1,78 @@
+#ifndef __BLE_RPA_CACHE_H
+#define __BLE_RPA_CACHE_H
+
+#include "ble_rpa.h"
+
+// Slots probed from the home slot of an address before one is evicted
+#define BT_RPA_CACHE_PROBES		8
+
+// Largest table: 1 << 24 slots, 256 MB of entries
+#define BT_RPA_CACHE_MAX_BITS	24
+
+// One cached resolution. Address 0 never is an RPA, so Key == 0 marks
+// a slot that has never been used.
+typedef struct _BT_RPA_CACHE_ENTRY
+{
+	unsigned long long Key;			// 48 bit address, addr[0] most significant
+	int Identity;					// IRK handle, or -1 for "known unresolvable"
+	unsigned int Expires;			// time after which the entry is stale
+} BT_RPA_CACHE_ENTRY;
+
+// Fixed size, open addressing cache from RPA to identity. Entries live for
+// Ttl time units (an RPA rotates about every 15 minutes) and are all
+// dropped when the generation of the IRK table they came from changes.
+typedef struct _BT_RPA_CACHE
+{
+	BT_RPA_CACHE_ENTRY *Entries;	// 1 << Bits slots
+	unsigned int Mask;				// slots - 1
+	unsigned int Ttl;				// lifetime of an entry
+	unsigned int Generation;		// IRK table generation of the entries
+	unsigned int Hits;
+	unsigned int Misses;
+} BT_RPA_CACHE;
+
+// Returns 0 when out of memory or Bits is outside 1..BT_RPA_CACHE_MAX_BITS.
+// A cache that failed Init or was freed is empty: lookups miss, inserts
+// are dropped and Bt_RPA_ResolveCached is plain Bt_RPA_Resolve.
+int Bt_RpaCacheInit(
+	BT_RPA_CACHE *pCache,
+	int Bits,
+	unsigned int Ttl
+	);
+
+void Bt_RpaCacheFree(
+	BT_RPA_CACHE *pCache
+	);
+
+void Bt_RpaCacheFlush(
+	BT_RPA_CACHE *pCache
+	);
+
+int Bt_RpaCacheLookup(
+	BT_RPA_CACHE *pCache,
+	const unsigned char addr[6],
+	unsigned int Now,
+	int *identity
+	);
+
+void Bt_RpaCacheInsert(
+	BT_RPA_CACHE *pCache,
+	const unsigned char addr[6],
+	int identity,
+	unsigned int Now
+	);
+
+// Bt_RPA_Resolve with the cache in front: hits cost one lookup, the misses
+// are resolved together in one batch and then cached.
+int Bt_RPA_ResolveCached(
+	BT_RPA_CACHE *pCache,
+	const BT_IRK_TABLE *pTable,
+	const unsigned char (*addr)[6],
+	int Count,
+	unsigned int Now,
+	int *identity
+	);
+
+void Bt_RPA_Cache_Test();
+
+#endif
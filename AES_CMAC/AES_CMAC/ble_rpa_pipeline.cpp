@@ -0,0 +1,407 @@
+/****************************************************************/
+/* Streaming RPA resolution                                     */
+/* LE Advertising Reports -> SPSC ring -> filter thread ->      */
+/* MPMC work ring -> resolver threads -> MPMC completion ring.  */
+/* The rings are bounded and lock free; a full ring makes the   */
+/* producer yield, so a slow consumer throttles the stage that  */
+/* feeds it instead of growing a queue.                         */
+/****************************************************************/
+#include "stdafx.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "ble_rpa.h"
+#include "ble_rpa_cache.h"
+#include "ble_rpa_pipeline.h"
+#include "ble_ring.h"
+#include "ble_smp_crypto.h"
+#include "crypto_helper.h"
+
+#define BT_ADV_REPORT_SUBEVENT	0x02
+#define BT_ADDR_TYPE_RANDOM		0x01
+
+// Addresses a worker takes from the work ring per Bt_RPA_Resolve call
+#define BT_RPA_WORKER_BATCH		32
+
+// Per worker cache: 4096 slots, entries live 900 s (one RPA rotation)
+#define BT_RPA_WORKER_CACHE_BITS	12
+#define BT_RPA_WORKER_CACHE_TTL		900
+
+typedef struct _BT_ADV_EVENT
+{
+	int Length;
+	unsigned char Data[BT_ADV_EVENT_MAX];
+} BT_ADV_EVENT;
+
+typedef struct _BT_RPA_WORK
+{
+	unsigned char Addr[6];
+	unsigned int Seq;
+} BT_RPA_WORK;
+
+struct _BT_RPA_PIPELINE
+{
+	const BT_IRK_TABLE *Table;
+	BtSpscRing<BT_ADV_EVENT, 1024> Events;
+	BtMpmcRing<BT_RPA_WORK, 4096> Work;
+	BtMpmcRing<BT_RPA_RESULT, 4096> Done;
+
+	std::atomic<bool> Stop;
+	std::atomic<unsigned int> EventsIn;
+	std::atomic<unsigned int> EventsDone;
+	std::atomic<unsigned int> Dropped;
+	std::atomic<unsigned int> Reports;
+	std::atomic<unsigned int> Rpas;
+	std::atomic<unsigned int> Completed;
+	std::atomic<unsigned int> Resolved;
+
+	std::thread Filter;
+	std::thread Workers[BT_RPA_MAX_WORKERS];
+	int WorkerCount;
+	std::chrono::steady_clock::time_point Start;
+};
+
+static void FilterMain(BT_RPA_PIPELINE *p)
+{
+	BT_ADV_EVENT event;
+	BT_RPA_WORK work;
+	unsigned char addr[BT_ADV_REPORTS_MAX][6];
+	unsigned char addr_type[BT_ADV_REPORTS_MAX];
+	unsigned int seq = 0;
+	int n, i;
+
+	while (!p->Stop.load(std::memory_order_relaxed))
+	{
+		if (!p->Events.Pop(event))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		n = Bt_AdvReportParse(event.Data, event.Length, addr, addr_type, BT_ADV_REPORTS_MAX);
+		p->Reports.fetch_add(n, std::memory_order_relaxed);
+		for (i = 0; i < n; i++)
+		{
+			if (addr_type[i] != BT_ADDR_TYPE_RANDOM || !Bt_RPA_IsResolvable(addr[i])) continue;
+			memcpy(work.Addr, addr[i], 6);
+			work.Seq = seq++;
+			p->Rpas.fetch_add(1, std::memory_order_relaxed);
+			while (!p->Work.Push(work))
+			{
+				if (p->Stop.load(std::memory_order_relaxed)) return;
+				std::this_thread::yield();
+			}
+		}
+		p->EventsDone.fetch_add(1, std::memory_order_release);
+	}
+}
+
+static void WorkerMain(BT_RPA_PIPELINE *p)
+{
+	BT_RPA_WORK work[BT_RPA_WORKER_BATCH];
+	unsigned char addr[BT_RPA_WORKER_BATCH][6];
+	int identity[BT_RPA_WORKER_BATCH];
+	BT_RPA_RESULT result;
+	BT_RPA_CACHE cache;
+	unsigned int now;
+	int n, i, resolved, cached;
+
+	// Private cache: no sharing between workers, so no locks around it.
+	// Out of memory the worker still resolves, only without a cache.
+	cached = Bt_RpaCacheInit(&cache, BT_RPA_WORKER_CACHE_BITS, BT_RPA_WORKER_CACHE_TTL);
+
+	while (!p->Stop.load(std::memory_order_relaxed))
+	{
+		n = 0;
+		while (n < BT_RPA_WORKER_BATCH && p->Work.Pop(work[n])) n++;
+		if (n == 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		for (i = 0; i < n; i++) memcpy(addr[i], work[i].Addr, 6);
+		now = (unsigned int)std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::steady_clock::now() - p->Start).count();
+		if (cached) resolved = Bt_RPA_ResolveCached(&cache, p->Table, addr, n, now, identity);
+		else resolved = Bt_RPA_Resolve(p->Table, addr, n, identity);
+
+		for (i = 0; i < n; i++)
+		{
+			memcpy(result.Addr, work[i].Addr, 6);
+			result.Identity = identity[i];
+			result.Seq = work[i].Seq;
+			while (!p->Done.Push(result))
+			{
+				if (p->Stop.load(std::memory_order_relaxed)) break;
+				std::this_thread::yield();
+			}
+		}
+		p->Resolved.fetch_add(resolved, std::memory_order_relaxed);
+		p->Completed.fetch_add(n, std::memory_order_release);
+	}
+	Bt_RpaCacheFree(&cache);
+}
+
+BT_RPA_PIPELINE *Bt_RpaPipelineCreate(
+	const BT_IRK_TABLE *pTable,
+	int Workers
+	)
+{
+	BT_RPA_PIPELINE *p = new BT_RPA_PIPELINE;
+	int i;
+
+	if (Workers < 1) Workers = 1;
+	if (Workers > BT_RPA_MAX_WORKERS) Workers = BT_RPA_MAX_WORKERS;
+
+	p->Table = pTable;
+	p->Stop = false;
+	p->EventsIn = p->EventsDone = p->Dropped = 0;
+	p->Reports = p->Rpas = p->Completed = p->Resolved = 0;
+	p->WorkerCount = Workers;
+	p->Start = std::chrono::steady_clock::now();
+
+	p->Filter = std::thread(FilterMain, p);
+	for (i = 0; i < Workers; i++)
+	{
+		p->Workers[i] = std::thread(WorkerMain, p);
+	}
+	return p;
+}
+
+int Bt_RpaPipelineSubmit(
+	BT_RPA_PIPELINE *pPipeline,
+	const unsigned char *pEvent,
+	int Length
+	)
+{
+	BT_ADV_EVENT event;
+
+	if (Length < 0 || Length > BT_ADV_EVENT_MAX)
+	{
+		pPipeline->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return -1;
+	}
+	event.Length = Length;
+	memcpy(event.Data, pEvent, Length);
+	if (!pPipeline->Events.Push(event)) return 0;
+	pPipeline->EventsIn.fetch_add(1, std::memory_order_relaxed);
+	return 1;
+}
+
+int Bt_RpaPipelinePoll(
+	BT_RPA_PIPELINE *pPipeline,
+	BT_RPA_RESULT *pResults,
+	int Max
+	)
+{
+	int n = 0;
+
+	while (n < Max && pPipeline->Done.Pop(pResults[n])) n++;
+	return n;
+}
+
+int Bt_RpaPipelineIdle(
+	BT_RPA_PIPELINE *pPipeline
+	)
+{
+	return pPipeline->EventsDone.load(std::memory_order_acquire) == pPipeline->EventsIn.load(std::memory_order_relaxed) &&
+		pPipeline->Completed.load(std::memory_order_acquire) == pPipeline->Rpas.load(std::memory_order_relaxed);
+}
+
+void Bt_RpaPipelineStats(
+	BT_RPA_PIPELINE *pPipeline,
+	BT_RPA_PIPELINE_STATS *pStats
+	)
+{
+	pStats->Events = pPipeline->EventsIn.load();
+	pStats->Dropped = pPipeline->Dropped.load();
+	pStats->Reports = pPipeline->Reports.load();
+	pStats->Rpas = pPipeline->Rpas.load();
+	pStats->Completed = pPipeline->Completed.load();
+	pStats->Resolved = pPipeline->Resolved.load();
+}
+
+void Bt_RpaPipelineDestroy(
+	BT_RPA_PIPELINE *pPipeline
+	)
+{
+	int i;
+
+	pPipeline->Stop = true;
+	pPipeline->Filter.join();
+	for (i = 0; i < pPipeline->WorkerCount; i++)
+	{
+		pPipeline->Workers[i].join();
+	}
+	delete pPipeline;
+}
+
+/*
+* LE Advertising Report event, parameters from the subevent code on:
+*
+*   Subevent_Code (0x02) | Num_Reports |
+*   { Event_Type | Address_Type | Address[6] | Length_Data | Data | RSSI } ...
+*
+* Reports are taken one after the other, the layout controllers send.
+*/
+int Bt_AdvReportParse(
+	const unsigned char *pEvent,
+	int Length,
+	unsigned char (*addr)[6],
+	unsigned char *addr_type,
+	int Max
+	)
+{
+	int num, pos, i, j, n = 0;
+
+	if (Length < 2 || pEvent[0] != BT_ADV_REPORT_SUBEVENT) return 0;
+	num = pEvent[1];
+	pos = 2;
+	for (i = 0; i < num && n < Max; i++)
+	{
+		// Event_Type, Address_Type, Address, Length_Data
+		if (pos + 9 > Length) break;
+		if (pos + 9 + pEvent[pos + 8] + 1 > Length) break;
+		addr_type[n] = pEvent[pos + 1];
+		for (j = 0; j < 6; j++)
+		{
+			addr[n][j] = pEvent[pos + 2 + 5 - j];
+		}
+		n++;
+		pos += 9 + pEvent[pos + 8] + 1;	// skip Data and RSSI
+	}
+	return n;
+}
+
+int Bt_AdvReportBuild(
+	const unsigned char addr[6],
+	unsigned char addr_type,
+	unsigned char *pEvent
+	)
+{
+	// Flags AD structure: LE General Discoverable, BR/EDR not supported
+	static const unsigned char ad[3] = { 0x02, 0x01, 0x06 };
+	int j;
+
+	pEvent[0] = BT_ADV_REPORT_SUBEVENT;
+	pEvent[1] = 1;				// Num_Reports
+	pEvent[2] = 0x00;			// ADV_IND
+	pEvent[3] = addr_type;
+	for (j = 0; j < 6; j++)
+	{
+		pEvent[4 + j] = addr[5 - j];
+	}
+	pEvent[10] = sizeof(ad);
+	memcpy(pEvent + 11, ad, sizeof(ad));
+	pEvent[11 + sizeof(ad)] = 0xC4;	// RSSI -60 dBm
+	return 12 + sizeof(ad);
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	Synthetic radio: 20000 advertising reports from 64 advertisers. Half of
+	them use an RPA hashed with one of 256 bonded IRKs, a quarter an RPA no
+	IRK matches and a quarter a public address. One more event packs 0x19
+	reports of the first 25 advertisers with no AD data (252 octets), and a
+	256 octet event must be dropped. Two resolver threads; the counts below
+	do not depend on thread timing.
+*/
+void Bt_RPA_Pipeline_Test()
+{
+	unsigned char irks[256][16];
+	unsigned char adv[64][6], adv_type[64];
+	unsigned char event[BT_ADV_EVENT_MAX + 1];
+	BT_RPA_RESULT results[256];
+	BT_RPA_PIPELINE_STATS stats;
+	BT_IRK_TABLE table;
+	BT_RPA_PIPELINE *pipeline;
+	unsigned int seed = 7;
+	int i, j, len, got, idle, received = 0, matched = 0;
+
+	for (i = 0; i < 256; i++)
+	{
+		for (j = 0; j < 16; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			irks[i][j] = (unsigned char)(seed >> 16);
+		}
+	}
+	Bt_IrkTableInit(&table, 256);
+	for (i = 0; i < 256; i++) Bt_IrkTableAdd(&table, irks[i]);
+
+	for (i = 0; i < 64; i++)
+	{
+		for (j = 0; j < 6; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			adv[i][j] = (unsigned char)(seed >> 16);
+		}
+		adv_type[i] = BT_ADDR_TYPE_RANDOM;
+		adv[i][0] = (adv[i][0] & 0x3F) | 0x40;
+		if (i % 4 < 2)
+		{
+			Bt_SMP_ah(irks[(i * 37) % 256], adv[i], adv[i] + 3);	// bonded
+		}
+		else if (i % 4 == 3)
+		{
+			adv_type[i] = 0x00;										// public
+		}
+	}
+
+	pipeline = Bt_RpaPipelineCreate(&table, 2);
+	for (i = 0; i < 20000; i++)
+	{
+		len = Bt_AdvReportBuild(adv[i % 64], adv_type[i % 64], event);
+		while (!Bt_RpaPipelineSubmit(pipeline, event, len))
+		{
+			got = Bt_RpaPipelinePoll(pipeline, results, 256);
+			for (j = 0; j < got; j++) matched += results[j].Identity >= 0;
+			received += got;
+		}
+	}
+	// One event with as many reports as the subevent allows
+	event[0] = BT_ADV_REPORT_SUBEVENT;
+	event[1] = BT_ADV_REPORTS_MAX;
+	for (i = 0, len = 2; i < BT_ADV_REPORTS_MAX; i++, len += 10)
+	{
+		event[len] = 0x00;						// ADV_IND
+		event[len + 1] = adv_type[i];
+		for (j = 0; j < 6; j++) event[len + 2 + j] = adv[i][5 - j];
+		event[len + 8] = 0;						// no AD data
+		event[len + 9] = 0xC4;					// RSSI
+	}
+	while (!Bt_RpaPipelineSubmit(pipeline, event, len))
+	{
+		got = Bt_RpaPipelinePoll(pipeline, results, 256);
+		for (j = 0; j < got; j++) matched += results[j].Identity >= 0;
+		received += got;
+	}
+	memset(event, 0, sizeof(event));
+	Bt_RpaPipelineSubmit(pipeline, event, BT_ADV_EVENT_MAX + 1);	// dropped, -1
+	// Results are in the completion ring before Completed counts them,
+	// so once idle whatever is left can be drained without waiting
+	do
+	{
+		idle = Bt_RpaPipelineIdle(pipeline);
+		got = Bt_RpaPipelinePoll(pipeline, results, 256);
+		for (j = 0; j < got; j++) matched += results[j].Identity >= 0;
+		received += got;
+		if (got == 0 && !idle) std::this_thread::yield();
+	} while (!idle || got > 0);
+	Bt_RpaPipelineStats(pipeline, &stats);
+	Bt_RpaPipelineDestroy(pipeline);
+
+	printf("--------------------------------------------------\n");
+	printf("Events         %u\n", stats.Events);
+	printf("Dropped        %u\n", stats.Dropped);
+	printf("Reports        %u\n", stats.Reports);
+	printf("RPAs           %u\n", stats.Rpas);
+	printf("Completed      %d\n", received);
+	printf("Resolved       %d\n", matched);
+	printf("--------------------------------------------------\n");
+
+	Bt_IrkTableFree(&table);
+}
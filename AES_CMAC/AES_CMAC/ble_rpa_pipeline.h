@@ -0,0 +1,100 @@
+#ifndef __BLE_RPA_PIPELINE_H
+#define __BLE_RPA_PIPELINE_H
+
+#include "ble_rpa.h"
+
+// Largest LE Advertising Report subevent: an HCI event carries at most
+// 255 parameter octets, of which Num_Reports may hold 0x01 to 0x19 reports
+#define BT_ADV_EVENT_MAX		255
+#define BT_ADV_REPORTS_MAX		0x19
+
+// Most resolver threads a pipeline runs
+#define BT_RPA_MAX_WORKERS		16
+
+// One resolved (or unresolvable) RPA handed back through the completion ring
+typedef struct _BT_RPA_RESULT
+{
+	unsigned char Addr[6];			// MSB first
+	int Identity;					// IRK handle, or -1
+	unsigned int Seq;				// order in which the RPA was seen
+} BT_RPA_RESULT;
+
+typedef struct _BT_RPA_PIPELINE_STATS
+{
+	unsigned int Events;			// advertising report events submitted
+	unsigned int Dropped;			// events refused as longer than BT_ADV_EVENT_MAX
+	unsigned int Reports;			// reports parsed from them
+	unsigned int Rpas;				// reports carrying an RPA, sent to the workers
+	unsigned int Completed;			// RPAs resolved (or found unresolvable)
+	unsigned int Resolved;			// of which matched an IRK
+} BT_RPA_PIPELINE_STATS;
+
+/*
+* Advertising reports -> RPA filter -> resolver workers -> completion ring.
+*
+* Events enter through an SPSC ring (one submitting thread, the radio or a
+* replay). A filter thread parses them and pushes every RPA into an MPMC
+* work ring. The workers take RPAs in batches, run Bt_RPA_Resolve behind a
+* private RPA cache and push results into an MPMC completion ring, which
+* the owner drains with Bt_RpaPipelinePoll. No stage takes a lock.
+*/
+typedef struct _BT_RPA_PIPELINE BT_RPA_PIPELINE;
+
+BT_RPA_PIPELINE *Bt_RpaPipelineCreate(
+	const BT_IRK_TABLE *pTable,		// must outlive the pipeline, read only
+	int Workers
+	);
+
+// Queue one LE Advertising Report subevent (starting with the subevent
+// code 0x02). Returns 1 when queued, 0 when the input ring is full (try
+// again later) and -1, counted in Dropped, for an event longer than
+// BT_ADV_EVENT_MAX, which no controller sends.
+int Bt_RpaPipelineSubmit(
+	BT_RPA_PIPELINE *pPipeline,
+	const unsigned char *pEvent,
+	int Length
+	);
+
+// Take up to Max results; returns how many were taken
+int Bt_RpaPipelinePoll(
+	BT_RPA_PIPELINE *pPipeline,
+	BT_RPA_RESULT *pResults,
+	int Max
+	);
+
+// Nonzero once every submitted event has been filtered and every RPA resolved
+int Bt_RpaPipelineIdle(
+	BT_RPA_PIPELINE *pPipeline
+	);
+
+void Bt_RpaPipelineStats(
+	BT_RPA_PIPELINE *pPipeline,
+	BT_RPA_PIPELINE_STATS *pStats
+	);
+
+void Bt_RpaPipelineDestroy(
+	BT_RPA_PIPELINE *pPipeline
+	);
+
+// Parse an LE Advertising Report subevent. Addresses come over HCI least
+// significant octet first and are returned MSB first. Returns the number
+// of reports written to addr/addr_type.
+int Bt_AdvReportParse(
+	const unsigned char *pEvent,
+	int Length,
+	unsigned char (*addr)[6],
+	unsigned char *addr_type,
+	int Max
+	);
+
+// Synthetic stand-in for the radio: builds one advertising report event
+// for addr (MSB first) and returns its length.
+int Bt_AdvReportBuild(
+	const unsigned char addr[6],
+	unsigned char addr_type,
+	unsigned char *pEvent
+	);
+
+void Bt_RPA_Pipeline_Test();
+
+#endif
@@ -1,6 +1,8 @@
 ﻿#include "stdafx.h"
 #include "aes_encrypt.h"
 #include "aes_cmac.h"
+#include "ble_smp_crypto.h"
+#include "ble_smp_keys.h"
 #include "crypto_helper.h"
 
 /*********************Legacy Pairing***********************************/
@@ -26,6 +28,19 @@ void Bt_SMP_e(
 	AES_128(pKey, pPlainTextData, pEncryptedData);
 }
 
+/*
+* Security function e with a key already expanded by AES_128_ExpandKey.
+* Used when several blocks are encrypted under the same IRK, LTK or TK.
+*/
+void Bt_SMP_e_Expanded(
+	const AES_EXPANDED_KEY *pKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	)
+{
+	AesEncryptBlock(pKey, pPlainTextData, pEncryptedData);
+}
+
 /*
 * Random Address Hash function ah
 *
@@ -78,6 +93,30 @@ void Bt_SMP_ah(
 	memcpy(hash, encrypted+13, 3);
 }
 
+/*
+* Random Address Hash function ah with a pre-expanded IRK, so that
+* checking many addresses against one IRK skips the key expansion.
+*/
+void Bt_SMP_ah_Expanded(
+	const AES_EXPANDED_KEY *k,
+	unsigned char r[3],
+	unsigned char hash[3]
+	)
+{
+	unsigned char rp[16];
+	unsigned char encrypted[16];
+
+	/* r' = padding || r */
+	memset(rp, 0, 16);
+	memcpy(rp+13, r, 3);
+
+	/* e(k, r') */
+	Bt_SMP_e_Expanded(k, rp, encrypted);
+
+	/* ah(k, r) = e(k, r') mod 2^24 */
+	memcpy(hash, encrypted+13, 3);
+}
+
 /*
 * Confirm value generation function c1
 *
@@ -143,6 +182,15 @@ void Bt_SMP_c1(
 	)
 {
 	unsigned char p1[16], p2[16];
+	AES_EXPANDED_KEY key;
+	const AES_EXPANDED_KEY *pKey;
+
+	/* both e() calls below use k, expand it once; the Just Works TK is prebuilt */
+	pKey = Bt_SMP_FixedKey(k);
+	if (pKey == NULL) {
+		AES_128_ExpandKey(k, &key);
+		pKey = &key;
+	}
 
 	/* p1 = pres || preq || _rat || _iat */
 	memcpy(p1, pres, 7);
@@ -159,13 +207,16 @@ void Bt_SMP_c1(
 	xor_128(r, p1, res);
 
 	/* res = e(k, res) */
-	Bt_SMP_e(k, res, res);
+	Bt_SMP_e_Expanded(pKey, res, res);
 
 	/* res = res XOR p2 */
 	xor_128(res, p2, res);
 
 	/* res = e(k, res) */
-	Bt_SMP_e(k, res, res);
+	Bt_SMP_e_Expanded(pKey, res, res);
+
+	/* the prebuilt Just Works key is shared, only a local TK schedule is wiped */
+	if (pKey == &key) SecureWipe(&key, sizeof(key));
 }
 
 /*
@@ -206,10 +257,150 @@ void Bt_SMP_s1(
 	unsigned char res[16]
 	)
 {
+	const AES_EXPANDED_KEY *pKey = Bt_SMP_FixedKey(k);
+
 	memcpy(res, r1+8, 8);
 	memcpy(res + 8, r2+8, 8);
 
-	Bt_SMP_e(k, res, res);
+	if (pKey != NULL)
+		Bt_SMP_e_Expanded(pKey, res, res);
+	else
+		Bt_SMP_e(k, res, res);
+}
+
+/*
+* Legacy pairing context
+*
+* Within one legacy pairing c1 always runs under the same TK with the same
+* p1 and p2 (both confirm values and both checks), and s1 under that TK
+* again. The context expands TK and builds p1 and p2 once.
+*/
+void Bt_SMP_LegacyInit(
+	BT_SMP_LEGACY *ctx,
+	unsigned char tk[16],
+	unsigned char pres[7],
+	unsigned char preq[7],
+	unsigned char iat,
+	unsigned char ia[6],
+	unsigned char rat,
+	unsigned char ra[6]
+	)
+{
+	const AES_EXPANDED_KEY *pKey = Bt_SMP_FixedKey(tk);
+
+	if (pKey != NULL)
+		memcpy(&ctx->Tk, pKey, sizeof(AES_EXPANDED_KEY));
+	else
+		AES_128_ExpandKey(tk, &ctx->Tk);
+
+	/* p1 = pres || preq || _rat || _iat */
+	memcpy(ctx->P1, pres, 7);
+	memcpy(ctx->P1 + 7, preq, 7);
+	ctx->P1[14] = rat;
+	ctx->P1[15] = iat;
+
+	/* p2 = padding || ia || ra */
+	memset(ctx->P2, 0, 16);
+	memcpy(ctx->P2 + 4, ia, 6);
+	memcpy(ctx->P2 + 10, ra, 6);
+}
+
+// c1(TK, r, ...) of the context
+void Bt_SMP_LegacyConfirm(
+	const BT_SMP_LEGACY *ctx,
+	unsigned char r[16],
+	unsigned char res[16]
+	)
+{
+	xor_128(r, (unsigned char *)ctx->P1, res);
+	Bt_SMP_e_Expanded(&ctx->Tk, res, res);
+	xor_128(res, (unsigned char *)ctx->P2, res);
+	Bt_SMP_e_Expanded(&ctx->Tk, res, res);
+}
+
+// Nonzero when confirm = c1(TK, r, ...); the comparison does not stop early
+int Bt_SMP_LegacyVerify(
+	const BT_SMP_LEGACY *ctx,
+	unsigned char r[16],
+	const unsigned char confirm[16]
+	)
+{
+	unsigned char res[16];
+	unsigned char diff = 0;
+	int i;
+
+	Bt_SMP_LegacyConfirm(ctx, r, res);
+	for (i = 0; i < 16; i++) diff |= res[i] ^ confirm[i];
+	return diff == 0;
+}
+
+// STK = s1(TK, Srand, Mrand)
+void Bt_SMP_LegacyStk(
+	const BT_SMP_LEGACY *ctx,
+	unsigned char srand[16],
+	unsigned char mrand[16],
+	unsigned char stk[16]
+	)
+{
+	memcpy(stk, srand + 8, 8);
+	memcpy(stk + 8, mrand + 8, 8);
+	Bt_SMP_e_Expanded(&ctx->Tk, stk, stk);
+}
+
+/*
+* c1 for many sessions at once: res[i] = c1 of ppCtx[i] over r[i]. Each
+* of the two e() steps runs as one multi-key AesEncryptBlocks call.
+*/
+void Bt_SMP_LegacyConfirmBatch(
+	const BT_SMP_LEGACY *const *ppCtx,
+	unsigned char (*r)[16],
+	unsigned char (*res)[16],
+	int Count
+	)
+{
+	const AES_EXPANDED_KEY *keys[BT_SMP_LEGACY_BATCH];
+	int base, n, i;
+
+	for (base = 0; base < Count; base += n)
+	{
+		n = Count - base < BT_SMP_LEGACY_BATCH ? Count - base : BT_SMP_LEGACY_BATCH;
+		for (i = 0; i < n; i++)
+		{
+			keys[i] = &ppCtx[base + i]->Tk;
+			xor_128(r[base + i], (unsigned char *)ppCtx[base + i]->P1, res[base + i]);
+		}
+		AesEncryptBlocks(keys, res[base], res[base], n);
+		for (i = 0; i < n; i++)
+		{
+			xor_128(res[base + i], (unsigned char *)ppCtx[base + i]->P2, res[base + i]);
+		}
+		AesEncryptBlocks(keys, res[base], res[base], n);
+	}
+}
+
+// STKs for many sessions at once: stk[i] = s1 of ppCtx[i] over srand[i], mrand[i]
+void Bt_SMP_LegacyStkBatch(
+	const BT_SMP_LEGACY *const *ppCtx,
+	unsigned char (*srand)[16],
+	unsigned char (*mrand)[16],
+	unsigned char (*stk)[16],
+	int Count
+	)
+{
+	const AES_EXPANDED_KEY *keys[BT_SMP_LEGACY_BATCH];
+	int base, n, i;
+
+	for (base = 0; base < Count; base += n)
+	{
+		n = Count - base < BT_SMP_LEGACY_BATCH ? Count - base : BT_SMP_LEGACY_BATCH;
+		for (i = 0; i < n; i++)
+		{
+			keys[i] = &ppCtx[base + i]->Tk;
+			memcpy(stk[base + i], srand[base + i] + 8, 8);
+			memcpy(stk[base + i] + 8, mrand[base + i] + 8, 8);
+		}
+		AesEncryptBlocks(keys, stk[base], stk[base], n);
+	}
 }
 
 /*********************LE Security Connections******************************/
@@ -222,13 +413,52 @@ void Bt_SMP_f4(
 	unsigned char res[16]
 )
 {
-	unsigned char m[65];
+	/* m = u || v || z, read in place */
+	AES_CMAC_SEGMENT m[3] = { { u, 32 }, { v, 32 }, { &z, 1 } };
+	AES_CMAC_KEY key;
 
-	memcpy(&m[0], u, 32);
-	memcpy(&m[32], v, 32);
-	m[64] = z;
+	AES_CMAC_Init(&key, x);
+	AES_CMAC_SignSegments(&key, m, 3, res);
+	SecureWipe(&key, sizeof(key));
+}
 
-	AES_CMAC(x, m, sizeof(m), res);
+/*
+* Passkey entry confirm values of one side for all 20 rounds:
+*
+*   C[i] = f4(u, v, N[i], 0x80 | bit i of the passkey)
+*
+* Each round is keyed by its own nonce, so nothing carries over between
+* rounds; the 20 CMACs run as one batch over the interleaved lanes. Only
+* the local side's values can be made ahead like this, the peer's nonce
+* of a round arrives after its confirm.
+*/
+void Bt_SMP_f4_Passkey(
+	unsigned char u[32],
+	unsigned char v[32],
+	unsigned char n[BT_SMP_PASSKEY_ROUNDS][16],
+	unsigned int passkey,
+	unsigned char res[BT_SMP_PASSKEY_ROUNDS][16]
+)
+{
+	AES_CMAC_KEY keys[BT_SMP_PASSKEY_ROUNDS];
+	AES_CMAC_SEGMENT m[BT_SMP_PASSKEY_ROUNDS][3];
+	AES_CMAC_JOB jobs[BT_SMP_PASSKEY_ROUNDS];
+	unsigned char z[BT_SMP_PASSKEY_ROUNDS];
+	int i;
+
+	memset(jobs, 0, sizeof(jobs));
+	for (i = 0; i < BT_SMP_PASSKEY_ROUNDS; i++)
+	{
+		z[i] = 0x80 | ((passkey >> i) & 1);
+		m[i][0].data = u; m[i][0].length = 32;
+		m[i][1].data = v; m[i][1].length = 32;
+		m[i][2].data = &z[i]; m[i][2].length = 1;
+		AES_CMAC_Init(&keys[i], n[i]);
+		jobs[i].key = &keys[i]; jobs[i].segments = m[i]; jobs[i].segment_count = 3; jobs[i].mac = res[i];
+	}
+	AES_CMAC_Batch(jobs, BT_SMP_PASSKEY_ROUNDS);
+	SecureWipe(keys, sizeof(keys));
+	SecureWipe(z, sizeof(z));
 }
 
 // LE Secure Connections Key Generation Function f5
@@ -243,24 +473,31 @@ void Bt_SMP_f5(
 )
 {
 	unsigned char btle[4] = { 0x62, 0x74, 0x6c, 0x65 };	//keyID: "btle" 
-	unsigned char salt[16] = { 0x6C, 0x88, 0x83, 0x91, 0xAA, 0xF5, 0xA5, 0x38, 0x60, 0x37, 0x0B, 0xDB, 0x5A, 0x60, 0x83, 0xBE };
 	unsigned char length[2] = { 0x01, 0x00 };
-	unsigned char m[53], t[16];
-
-	AES_CMAC(salt, w, 32, t);
-
-	memcpy(&m[1], btle, 4);
-	memcpy(&m[5], n1, 16);
-	memcpy(&m[21], n2, 16);
-	memcpy(&m[37], a1, 7);
-	memcpy(&m[44], a2, 7);
-	memcpy(&m[51], length, 2);
-
-	m[0] = 0; /* Counter */
-	AES_CMAC(t, m, sizeof(m), mackey);
-
-	m[0] = 1; /* Counter */
-	AES_CMAC(t, m, sizeof(m), ltk);
+	unsigned char counter[2] = { 0, 1 };
+	unsigned char t[16];
+	AES_CMAC_KEY key_t;
+	AES_CMAC_JOB jobs[2];
+	/* m = Counter || keyID || N1 || N2 || A1 || A2 || Length, read in place */
+	AES_CMAC_SEGMENT m[2][7] = {
+		{ { &counter[0], 1 }, { btle, 4 }, { n1, 16 }, { n2, 16 }, { a1, 7 }, { a2, 7 }, { length, 2 } },
+		{ { &counter[1], 1 }, { btle, 4 }, { n1, 16 }, { n2, 16 }, { a1, 7 }, { a2, 7 }, { length, 2 } }
+	};
+
+	/* T = AES-CMAC(SALT, W); the SALT schedule and subkeys are prebuilt */
+	AES_CMAC_Sign(&Bt_SMP_SaltKey, w, 32, t);
+
+	/*
+	* MacKey and LTK are both keyed by T: set it up once and run the two
+	* chains side by side, the messages only differ in the counter.
+	*/
+	AES_CMAC_Init(&key_t, t);
+	memset(jobs, 0, sizeof(jobs));
+	jobs[0].key = &key_t; jobs[0].segments = m[0]; jobs[0].segment_count = 7; jobs[0].mac = mackey;
+	jobs[1].key = &key_t; jobs[1].segments = m[1]; jobs[1].segment_count = 7; jobs[1].mac = ltk;
+	AES_CMAC_Batch(jobs, 2);
+	SecureWipe(&key_t, sizeof(key_t));
+	SecureWipe(t, sizeof(t));
 }
 
 //LE Secure Connections Check Value Generation Function f6
@@ -275,16 +512,50 @@ void Bt_SMP_f6(
 	unsigned char res[16]
 )
 {
-	unsigned char m[65];
+	/* m = N1 || N2 || R || IOcap || A1 || A2, read in place */
+	AES_CMAC_SEGMENT m[6] = { { n1, 16 }, { n2, 16 }, { r, 16 }, { io_cap, 3 }, { a1, 7 }, { a2, 7 } };
+	AES_CMAC_KEY key;
 
-	memcpy(&m[0], n1, 16);
-	memcpy(&m[16], n2, 16);
-	memcpy(&m[32], r, 16);
-	memcpy(&m[48], io_cap, 3);
-	memcpy(&m[51], a1, 7);
-	memcpy(&m[58], a2, 7);
+	AES_CMAC_Init(&key, w);
+	AES_CMAC_SignSegments(&key, m, 6, res);
+	SecureWipe(&key, sizeof(key));
+}
 
-	AES_CMAC(w, m, sizeof(m), res);
+/*
+* Both DHKey check values of one pairing under the same MacKey:
+*
+*   Ea = f6(MacKey, Na, Nb, rb, IOcapA, A, B)
+*   Eb = f6(MacKey, Nb, Na, ra, IOcapB, B, A)
+*
+* The key is set up once and the two chains are interleaved.
+*/
+void Bt_SMP_f6_EaEb(
+	unsigned char w[16],
+	unsigned char na[16],
+	unsigned char nb[16],
+	unsigned char ra[16],
+	unsigned char rb[16],
+	unsigned char io_cap_a[3],
+	unsigned char io_cap_b[3],
+	unsigned char a[7],
+	unsigned char b[7],
+	unsigned char ea[16],
+	unsigned char eb[16]
+)
+{
+	AES_CMAC_SEGMENT m[2][6] = {
+		{ { na, 16 }, { nb, 16 }, { rb, 16 }, { io_cap_a, 3 }, { a, 7 }, { b, 7 } },
+		{ { nb, 16 }, { na, 16 }, { ra, 16 }, { io_cap_b, 3 }, { b, 7 }, { a, 7 } }
+	};
+	AES_CMAC_KEY key;
+	AES_CMAC_JOB jobs[2];
+
+	AES_CMAC_Init(&key, w);
+	memset(jobs, 0, sizeof(jobs));
+	jobs[0].key = &key; jobs[0].segments = m[0]; jobs[0].segment_count = 6; jobs[0].mac = ea;
+	jobs[1].key = &key; jobs[1].segments = m[1]; jobs[1].segment_count = 6; jobs[1].mac = eb;
+	AES_CMAC_Batch(jobs, 2);
+	SecureWipe(&key, sizeof(key));
 }
 
 //  LE Secure Connections Numeric Comparison Value Generation Function g2
@@ -296,13 +567,14 @@ void Bt_SMP_g2(
 	unsigned char val[4]
 	)
 {
-	unsigned char m[80], tmp[16];
+	/* m = U || V || Y, read in place */
+	AES_CMAC_SEGMENT m[3] = { { u, 32 }, { v, 32 }, { y, 16 } };
+	AES_CMAC_KEY key;
+	unsigned char tmp[16];
 
-	memcpy(&m[0], u, 32);
-	memcpy(&m[32], v, 32);
-	memcpy(&m[64], y, 16);
-
-	AES_CMAC(x, m, sizeof(m), tmp);
+	AES_CMAC_Init(&key, x);
+	AES_CMAC_SignSegments(&key, m, 3, tmp);
+	SecureWipe(&key, sizeof(key));
 
 	memcpy(val, &tmp[12], 4);
 	//*val = GetUnalignedU32(&tmp[12]);
@@ -350,6 +622,11 @@ void Bt_SMP_c1_Test()
 	unsigned char ia[6] = { 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6 };
 	unsigned char ra[6] = { 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6 };
 	unsigned char res[16] = { 0 };
+	unsigned char confirm[16];
+	unsigned char tk[40][16], rb[40][16], cb[40][16];
+	BT_SMP_LEGACY ctx, batch[40];
+	const BT_SMP_LEGACY *pBatch[40];
+	int ok, same = 0, i;
 
 	printf("--------------------------------------------------\n");
 	printf("k              "); print128(k); printf("\n");
@@ -362,6 +639,32 @@ void Bt_SMP_c1_Test()
 	printf("ra             "); printBytes(ra, sizeof(ra)); printf("\n");
 	Bt_SMP_c1(k, r, pres, preq, iat, ia, rat, ra, res);
 	printf("\nBt_SMP_c1      "); print128(res); printf("\n");
+
+	Bt_SMP_LegacyInit(&ctx, k, pres, preq, iat, ia, rat, ra);
+	Bt_SMP_LegacyConfirm(&ctx, r, confirm);
+	printf("Legacy context "); print128(confirm); printf(" %s\n", memcmp(confirm, res, 16) == 0 ? "match" : "MISMATCH");
+	ok = Bt_SMP_LegacyVerify(&ctx, r, res);
+	res[15] ^= 0x01;
+	printf("  verify       %s, tampered %s\n", ok ? "ok" : "FAILED", Bt_SMP_LegacyVerify(&ctx, r, res) ? "ACCEPTED" : "refused");
+
+	/* 40 sessions, TK = passkey i, against c1 one by one */
+	for (i = 0; i < 40; i++)
+	{
+		memset(tk[i], 0, 16);
+		tk[i][14] = (unsigned char)(i >> 8);
+		tk[i][15] = (unsigned char)i;
+		memcpy(rb[i], r, 16);
+		rb[i][0] = (unsigned char)i;
+		Bt_SMP_LegacyInit(&batch[i], tk[i], pres, preq, iat, ia, rat, ra);
+		pBatch[i] = &batch[i];
+	}
+	Bt_SMP_LegacyConfirmBatch(pBatch, rb, cb, 40);
+	for (i = 0; i < 40; i++)
+	{
+		Bt_SMP_c1(tk[i], rb[i], pres, preq, iat, ia, rat, ra, res);
+		if (memcmp(res, cb[i], 16) == 0) same++;
+	}
+	printf("  batch        %d/40 match\n", same);
 	printf("--------------------------------------------------\n");
 }
 
@@ -381,6 +684,10 @@ void Bt_SMP_s1_Test()
 	unsigned char r1[16] = { 0x00, 0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
 	unsigned char r2[16] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00 };
 	unsigned char s1[16] = { 0 };
+	unsigned char pair[7] = { 0 }, addr[6] = { 0 };
+	unsigned char stk[2][16], srand[2][16], mrand[2][16], swapped[16];
+	BT_SMP_LEGACY ctx;
+	const BT_SMP_LEGACY *pCtx[2] = { &ctx, &ctx };
 	
 	printf("--------------------------------------------------\n");
 	printf("k              "); print128(k); printf("\n");
@@ -388,6 +695,15 @@ void Bt_SMP_s1_Test()
 	printf("r2             "); print128(r2); printf("\n");
 	Bt_SMP_s1(k, r1, r2, s1);
 	printf("\nBt_SMP_s1      "); print128(s1); printf("\n");
+
+	Bt_SMP_LegacyInit(&ctx, k, pair, pair, 0, addr, 0, addr);
+	Bt_SMP_LegacyStk(&ctx, r1, r2, stk[0]);
+	printf("Legacy context "); print128(stk[0]); printf(" %s\n", memcmp(stk[0], s1, 16) == 0 ? "match" : "MISMATCH");
+	memcpy(srand[0], r1, 16); memcpy(mrand[0], r2, 16);
+	memcpy(srand[1], r2, 16); memcpy(mrand[1], r1, 16);
+	Bt_SMP_LegacyStkBatch(pCtx, srand, mrand, stk, 2);
+	Bt_SMP_s1(k, r2, r1, swapped);
+	printf("  batch        %s\n", memcmp(stk[0], s1, 16) == 0 && memcmp(stk[1], swapped, 16) == 0 ? "match" : "MISMATCH");
 	printf("--------------------------------------------------\n");
 }
 
@@ -403,12 +719,17 @@ void Bt_SMP_ah_Test()
 	unsigned char k[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05, 0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
 	unsigned char r[3] = { 0x70, 0x81, 0x94 };
 	unsigned char hash[3] = { 0 };
+	AES_EXPANDED_KEY irk;
 
 	printf("--------------------------------------------------\n");
 	printf("k              "); print128(k); printf("\n");
 	printf("r              "); printBytes(r, sizeof(r)); printf("\n");
 	Bt_SMP_ah(k, r, hash);
 	printf("\nBt_SMP_ah      "); printBytes(hash, sizeof(hash)); printf("\n");
+
+	AES_128_ExpandKey(k, &irk);
+	Bt_SMP_ah_Expanded(&irk, r, hash);
+	printf("Bt_SMP_ah(IRK) "); printBytes(hash, sizeof(hash)); printf("\n");
 	printf("--------------------------------------------------\n");
 }
 
@@ -436,6 +757,8 @@ void Bt_SMP_f4_Test()
 							0x59, 0xcb, 0x9a, 0xc2, 0xf1, 0x9d, 0x7c, 0xfb, 0x6b, 0x4f, 0xdd, 0x49, 0xf4, 0x7f, 0xc5, 0xfd };
 	unsigned char z = 0x00;
 	unsigned char res[16] = { 0 };
+	unsigned char n[BT_SMP_PASSKEY_ROUNDS][16], confirm[BT_SMP_PASSKEY_ROUNDS][16];
+	int same = 0, i;
 
 	printf("--------------------------------------------------\n");
 	printf("x              "); print128(x); printf("\n");
@@ -444,6 +767,20 @@ void Bt_SMP_f4_Test()
 	printf("z              "); printBytes(&z, 1); printf("\n");
 	Bt_SMP_f4(u, v, x, z, res);
 	printf("\nBt_SMP_f4      "); print128(res); printf("\n");
+
+	/* passkey 123456 with nonces x, x+1, ... against 20 single f4 calls */
+	for (i = 0; i < BT_SMP_PASSKEY_ROUNDS; i++)
+	{
+		memcpy(n[i], x, 16);
+		n[i][15] += (unsigned char)i;
+	}
+	Bt_SMP_f4_Passkey(u, v, n, 123456, confirm);
+	for (i = 0; i < BT_SMP_PASSKEY_ROUNDS; i++)
+	{
+		Bt_SMP_f4(u, v, n[i], 0x80 | ((123456 >> i) & 1), res);
+		if (memcmp(res, confirm[i], 16) == 0) same++;
+	}
+	printf("Passkey rounds "); print128(confirm[0]); printf(" %d/%d match\n", same, BT_SMP_PASSKEY_ROUNDS);
 	printf("--------------------------------------------------\n");
 }
 
@@ -493,6 +830,7 @@ void Bt_SMP_f5_Test()
 	Bt_SMP_f5(w, n1, n2, a1, a2, MacKey, Ltk);
 	printf("\nLtk            "); print128(Ltk); printf("\n");
 	printf("MacKey         "); print128(MacKey); printf("\n");
+	printf("Fixed keys     %s\n", Bt_SMP_FixedKeys_Check() ? "match" : "MISMATCH");
 	printf("--------------------------------------------------\n");
 }
 
@@ -523,6 +861,7 @@ void Bt_SMP_f6_Test()
 	unsigned char a2[16] = { 0x00, 0xa7, 0x13, 0x70, 0x2d, 0xcf, 0xc1 };
 
 	unsigned char res[16] = { 0 };
+	unsigned char ea[16], eb[16];
 
 	printf("--------------------------------------------------\n");
 	printf("w              "); printBytes(w, sizeof(w)); printf("\n");
@@ -534,6 +873,12 @@ void Bt_SMP_f6_Test()
 	printf("a2             "); printBytes(a2, sizeof(a2)); printf("\n");
 	Bt_SMP_f6(w, n1, n2, r, io_cap, a1, a2, res);
 	printf("\nBt_SMP_f6      "); print128(res); printf("\n");
+
+	/* Ea from the same inputs, Eb with the roles swapped */
+	Bt_SMP_f6_EaEb(w, n1, n2, r, r, io_cap, io_cap, a1, a2, ea, eb);
+	Bt_SMP_f6(w, n2, n1, r, io_cap, a2, a1, res);
+	printf("Bt_SMP_f6 Ea   "); print128(ea); printf("\n");
+	printf("Bt_SMP_f6 Eb   "); print128(eb); printf(" %s\n", memcmp(eb, res, 16) == 0 ? "match" : "MISMATCH");
 	printf("--------------------------------------------------\n");
 }
 
@@ -1,6 +1,20 @@
 #ifndef __BLE_SMP_CRYPTO_H
 #define __BLE_SMP_CRYPTO_H
 
+#include "aes_encrypt.h"
+
+void Bt_SMP_e(
+	unsigned char *pKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
+void Bt_SMP_e_Expanded(
+	const AES_EXPANDED_KEY *pKey,
+	unsigned char *pPlainTextData,
+	unsigned char *pEncryptedData
+	);
+
 void Bt_SMP_c1(
 	unsigned char k[16],
 	unsigned char r[16],
@@ -13,12 +27,81 @@ void Bt_SMP_c1(
 	unsigned char res[16]
 	);
 
+void Bt_SMP_s1(
+	unsigned char k[16],
+	unsigned char r1[16],
+	unsigned char r2[16],
+	unsigned char res[16]
+	);
+
+// One legacy pairing: TK expanded once, p1 and p2 of c1 built once
+typedef struct _BT_SMP_LEGACY
+{
+	AES_EXPANDED_KEY Tk;
+	unsigned char P1[16];			// pres || preq || rat' || iat'
+	unsigned char P2[16];			// padding || ia || ra
+} BT_SMP_LEGACY;
+
+// Sessions per AesEncryptBlocks call in the batch forms
+#define BT_SMP_LEGACY_BATCH		64
+
+void Bt_SMP_LegacyInit(
+	BT_SMP_LEGACY *ctx,
+	unsigned char tk[16],
+	unsigned char pres[7],
+	unsigned char preq[7],
+	unsigned char iat,
+	unsigned char ia[6],
+	unsigned char rat,
+	unsigned char ra[6]
+	);
+
+void Bt_SMP_LegacyConfirm(
+	const BT_SMP_LEGACY *ctx,
+	unsigned char r[16],
+	unsigned char res[16]
+	);
+
+int Bt_SMP_LegacyVerify(
+	const BT_SMP_LEGACY *ctx,
+	unsigned char r[16],
+	const unsigned char confirm[16]
+	);
+
+void Bt_SMP_LegacyStk(
+	const BT_SMP_LEGACY *ctx,
+	unsigned char srand[16],
+	unsigned char mrand[16],
+	unsigned char stk[16]
+	);
+
+void Bt_SMP_LegacyConfirmBatch(
+	const BT_SMP_LEGACY *const *ppCtx,
+	unsigned char (*r)[16],
+	unsigned char (*res)[16],
+	int Count
+	);
+
+void Bt_SMP_LegacyStkBatch(
+	const BT_SMP_LEGACY *const *ppCtx,
+	unsigned char (*srand)[16],
+	unsigned char (*mrand)[16],
+	unsigned char (*stk)[16],
+	int Count
+	);
+
 void Bt_SMP_ah(
 	unsigned char k[16],
 	unsigned char r[3],
 	unsigned char hash[3]
 	);
 
+void Bt_SMP_ah_Expanded(
+	const AES_EXPANDED_KEY *k,
+	unsigned char r[3],
+	unsigned char hash[3]
+	);
+
 void Bt_SMP_f4(
 	unsigned char u[32],
 	unsigned char v[32],
@@ -27,6 +110,18 @@ void Bt_SMP_f4(
 	unsigned char res[16]
 	);
 
+// Passkey entry: one f4 round per passkey bit
+#define BT_SMP_PASSKEY_ROUNDS	20
+
+// The local confirm values of every round, nonce n[i] for round i
+void Bt_SMP_f4_Passkey(
+	unsigned char u[32],
+	unsigned char v[32],
+	unsigned char n[BT_SMP_PASSKEY_ROUNDS][16],
+	unsigned int passkey,
+	unsigned char res[BT_SMP_PASSKEY_ROUNDS][16]
+	);
+
 void Bt_SMP_f5(
 	unsigned char w[32],
 	unsigned char n1[16],
@@ -48,6 +143,20 @@ void Bt_SMP_f6(
 	unsigned char res[16]
 	);
 
+void Bt_SMP_f6_EaEb(
+	unsigned char w[16],
+	unsigned char na[16],
+	unsigned char nb[16],
+	unsigned char ra[16],
+	unsigned char rb[16],
+	unsigned char io_cap_a[3],
+	unsigned char io_cap_b[3],
+	unsigned char a[7],
+	unsigned char b[7],
+	unsigned char ea[16],
+	unsigned char eb[16]
+	);
+
 void Bt_SMP_g2(
 	unsigned char u[32],
 	unsigned char v[32],
@@ -0,0 +1,91 @@
+/****************************************************************/
+/* Key schedules of the constant keys used by SMP               */
+/* The f5 SALT and the all zero TK never change, so their       */
+/* round keys and CMAC subkeys K1/K2 are stored here instead of */
+/* being derived on every call. The tables were produced by     */
+/* AES_CMAC_Init; if the key schedule changes,                  */
+/* Bt_SMP_FixedKeys_Check reports it.                           */
+/****************************************************************/
+#include "stdafx.h"
+#include "aes_encrypt.h"
+#include "aes_cmac.h"
+#include "ble_smp_keys.h"
+
+/* SALT = 6C888391 AAF5A538 60370BDB 5A6083BE */
+const AES_CMAC_KEY Bt_SMP_SaltKey = {
+	{
+		{
+			0x6c, 0x88, 0x83, 0x91, 0xaa, 0xf5, 0xa5, 0x38, 0x60, 0x37, 0x0b, 0xdb, 0x5a, 0x60, 0x83, 0xbe,
+			0xbd, 0x64, 0x2d, 0x2f, 0x17, 0x91, 0x88, 0x17, 0x77, 0xa6, 0x83, 0xcc, 0x2d, 0xc6, 0x00, 0x72,
+			0x0b, 0x07, 0x6d, 0xf7, 0x1c, 0x96, 0xe5, 0xe0, 0x6b, 0x30, 0x66, 0x2c, 0x46, 0xf6, 0x66, 0x5e,
+			0x4d, 0x34, 0x35, 0xad, 0x51, 0xa2, 0xd0, 0x4d, 0x3a, 0x92, 0xb6, 0x61, 0x7c, 0x64, 0xd0, 0x3f,
+			0x06, 0x44, 0x40, 0xbd, 0x57, 0xe6, 0x90, 0xf0, 0x6d, 0x74, 0x26, 0x91, 0x11, 0x10, 0xf6, 0xae,
+			0xdc, 0x06, 0xa4, 0x3f, 0x8b, 0xe0, 0x34, 0xcf, 0xe6, 0x94, 0x12, 0x5e, 0xf7, 0x84, 0xe4, 0xf0,
+			0xa3, 0x6f, 0x28, 0x57, 0x28, 0x8f, 0x1c, 0x98, 0xce, 0x1b, 0x0e, 0xc6, 0x39, 0x9f, 0xea, 0x36,
+			0x38, 0xe8, 0x2d, 0x45, 0x10, 0x67, 0x31, 0xdd, 0xde, 0x7c, 0x3f, 0x1b, 0xe7, 0xe3, 0xd5, 0x2d,
+			0xa9, 0xeb, 0xf5, 0xd1, 0xb9, 0x8c, 0xc4, 0x0c, 0x67, 0xf0, 0xfb, 0x17, 0x80, 0x13, 0x2e, 0x3a,
+			0xcf, 0xda, 0x75, 0x1c, 0x76, 0x56, 0xb1, 0x10, 0x11, 0xa6, 0x4a, 0x07, 0x91, 0xb5, 0x64, 0x3d,
+			0x2c, 0x99, 0x52, 0x9d, 0x5a, 0xcf, 0xe3, 0x8d, 0x4b, 0x69, 0xa9, 0x8a, 0xda, 0xdc, 0xcd, 0xb7
+		},
+		10
+	},
+	{	/* K1 */
+		0x00, 0x38, 0xed, 0x02, 0x32, 0x8a, 0xa6, 0x50, 0x1d, 0xf5, 0x0c, 0x60, 0x43, 0xc5, 0xdd, 0x6f
+	},
+	{	/* K2 */
+		0x00, 0x71, 0xda, 0x04, 0x65, 0x15, 0x4c, 0xa0, 0x3b, 0xea, 0x18, 0xc0, 0x87, 0x8b, 0xba, 0xde
+	}
+};
+
+/* Zero key, TK of Just Works and of the c1/s1 sample data */
+const AES_CMAC_KEY Bt_SMP_ZeroKey = {
+	{
+		{
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+			0x62, 0x63, 0x63, 0x63, 0x62, 0x63, 0x63, 0x63, 0x62, 0x63, 0x63, 0x63, 0x62, 0x63, 0x63, 0x63,
+			0x9b, 0x98, 0x98, 0xc9, 0xf9, 0xfb, 0xfb, 0xaa, 0x9b, 0x98, 0x98, 0xc9, 0xf9, 0xfb, 0xfb, 0xaa,
+			0x90, 0x97, 0x34, 0x50, 0x69, 0x6c, 0xcf, 0xfa, 0xf2, 0xf4, 0x57, 0x33, 0x0b, 0x0f, 0xac, 0x99,
+			0xee, 0x06, 0xda, 0x7b, 0x87, 0x6a, 0x15, 0x81, 0x75, 0x9e, 0x42, 0xb2, 0x7e, 0x91, 0xee, 0x2b,
+			0x7f, 0x2e, 0x2b, 0x88, 0xf8, 0x44, 0x3e, 0x09, 0x8d, 0xda, 0x7c, 0xbb, 0xf3, 0x4b, 0x92, 0x90,
+			0xec, 0x61, 0x4b, 0x85, 0x14, 0x25, 0x75, 0x8c, 0x99, 0xff, 0x09, 0x37, 0x6a, 0xb4, 0x9b, 0xa7,
+			0x21, 0x75, 0x17, 0x87, 0x35, 0x50, 0x62, 0x0b, 0xac, 0xaf, 0x6b, 0x3c, 0xc6, 0x1b, 0xf0, 0x9b,
+			0x0e, 0xf9, 0x03, 0x33, 0x3b, 0xa9, 0x61, 0x38, 0x97, 0x06, 0x0a, 0x04, 0x51, 0x1d, 0xfa, 0x9f,
+			0xb1, 0xd4, 0xd8, 0xe2, 0x8a, 0x7d, 0xb9, 0xda, 0x1d, 0x7b, 0xb3, 0xde, 0x4c, 0x66, 0x49, 0x41,
+			0xb4, 0xef, 0x5b, 0xcb, 0x3e, 0x92, 0xe2, 0x11, 0x23, 0xe9, 0x51, 0xcf, 0x6f, 0x8f, 0x18, 0x8e
+		},
+		10
+	},
+	{	/* K1 */
+		0xcd, 0xd2, 0x97, 0xa9, 0xdf, 0x14, 0x58, 0x77, 0x10, 0x99, 0xf4, 0xb3, 0x94, 0x68, 0x56, 0x5c
+	},
+	{	/* K2 */
+		0x9b, 0xa5, 0x2f, 0x53, 0xbe, 0x28, 0xb0, 0xee, 0x21, 0x33, 0xe9, 0x67, 0x28, 0xd0, 0xac, 0x3f
+	}
+};
+
+const AES_EXPANDED_KEY *Bt_SMP_FixedKey(const unsigned char k[16])
+{
+	unsigned char acc = 0;
+	int i;
+
+	for (i = 0; i < 16; i++) acc |= k[i];
+	return acc ? NULL : &Bt_SMP_ZeroKey.Key;
+}
+
+static int CheckFixedKey(const unsigned char *pKey, const AES_CMAC_KEY *pFixed)
+{
+	AES_CMAC_KEY key;
+
+	AES_CMAC_Init(&key, (unsigned char *)pKey);
+	return memcmp(key.Key.RoundKey, pFixed->Key.RoundKey, 176) == 0 && key.Key.Nr == pFixed->Key.Nr &&
+		memcmp(key.K1, pFixed->K1, 16) == 0 && memcmp(key.K2, pFixed->K2, 16) == 0;
+}
+
+// Returns 1 when the stored tables match a run time expansion of the keys
+int Bt_SMP_FixedKeys_Check(void)
+{
+	unsigned char zero[16] = { 0 };
+
+	return CheckFixedKey(Bt_SMP_SaltKey.Key.RoundKey, &Bt_SMP_SaltKey) &&
+		CheckFixedKey(zero, &Bt_SMP_ZeroKey);
+}
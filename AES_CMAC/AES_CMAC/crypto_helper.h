@@ -1,6 +1,8 @@
 #ifndef __CRYPTO_HELPER
 #define __CRYPTO_HELPER
 
+#include <stddef.h>
+
 void xor_128(unsigned char *a, unsigned char *b, unsigned char *out);
 
 void print_hex(char *str, unsigned char *buf, int len);
@@ -21,4 +23,11 @@ void __PutUnalignedU64(unsigned long long Val, unsigned char *P);
 void PutUnalignedU16(unsigned short Val, unsigned char *P);
 void PutUnalignedU32(unsigned long Val, unsigned char *P);
 void PutUnalignedU64(unsigned long long Val, unsigned char *P);
+
+void *AlignedAlloc(size_t size, size_t align);
+void AlignedFree(void *p);
+
+void SecureWipe(void *p, size_t len);
+
+int OsRandomBytes(unsigned char *p, size_t len);
 #endif
\ No newline at end of file
@@ -3,6 +3,14 @@
 #include "aes_cmac.h"
 #include "aes_encrypt.h"
 #include "ble_smp_crypto.h"
+#include "ble_rpa.h"
+#include "ble_rpa_cache.h"
+#include "ble_rpa_pipeline.h"
+#include "ble_irk_set.h"
+#include "ble_bond_db.h"
+#include "ble_p256.h"
+#include "ble_p256_pool.h"
+#include "ble_tk_audit.h"
 
 void print_help(void)
 {
@@ -20,6 +28,15 @@ void print_help(void)
 	printf("			8			SMP_f6\n");
 	printf("			9			SMP_g2\n");
 	printf("			a			SMP_h6\n");
+	printf("			b			RPA resolve\n");
+	printf("			c			RPA cache\n");
+	printf("			d			RPA pipeline\n");
+	printf("			e			IRK set (RCU)\n");
+	printf("			f			RPA generate\n");
+	printf("			g			Bond DB\n");
+	printf("			i			P-256 ECDH\n");
+	printf("			j			P-256 key pool\n");
+	printf("			k			TK audit\n");
 	printf("			h			Help\n");
 	printf("			q			Quit\n");
 	printf("/*********************************************/\n");
@@ -67,6 +84,33 @@ int _tmain(int argc, _TCHAR* argv[])
 		case 'a':
 			Bt_SMP_h6_Test();
 			break;
+		case 'b':
+			Bt_RPA_Test();
+			break;
+		case 'c':
+			Bt_RPA_Cache_Test();
+			break;
+		case 'd':
+			Bt_RPA_Pipeline_Test();
+			break;
+		case 'e':
+			Bt_IrkSet_Test();
+			break;
+		case 'f':
+			Bt_RPA_Generate_Test();
+			break;
+		case 'g':
+			Bt_BondDb_Test();
+			break;
+		case 'i':
+			Bt_P256_Test();
+			break;
+		case 'j':
+			Bt_P256_Pool_Test();
+			break;
+		case 'k':
+			Bt_TkAudit_Test();
+			break;
 		case 'h':
 			print_help();
 		default: